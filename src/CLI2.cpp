@@ -1656,7 +1656,12 @@ void CLI2::insertIDExpr ()
         A2 argUUID ("uuid", Lexer::Type::dom);
         argUUID.tag ("FILTER");
 
-        reconstructed.push_back (openParen);
+        // The clause is marked, so that Filter may look up the tasks directly.
+        A2 openClause ("(", Lexer::Type::op);
+        openClause.tag ("FILTER");
+        openClause.tag ("ID");
+
+        reconstructed.push_back (openClause);
 
         // Add all ID ranges.
         for (auto r = _id_ranges.begin (); r != _id_ranges.end (); ++r)
@@ -60,6 +60,8 @@ std::string Config::_defaults =
   "\n"
   "# Files\n"
   "data.location=~/.task\n"
+  "data.journal=off                               # Journal changes to pending.data instead of rewriting it\n"
+  "data.journal.limit=100                         # Journal records before pending.data is rewritten\n"
   "locking=on                                     # Use file-level locking\n"
   "gc=on                                          # Garbage-collect data files - DO NOT CHANGE unless you are sure\n"
   "exit.on.missing.db=no                          # Whether to exit if ~/.task is not found\n"
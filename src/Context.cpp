@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
 #include <Context.h>
 #include <FS.h>
 #include <Eval.h>
@@ -45,6 +46,9 @@
 #include <commit.h>
 #endif
 
+// Urgency coefficients no larger than this are ignored, as in Task.cpp.
+static const float epsilon = 0.000001;
+
 // Supported modifiers, synonyms on the same line.
 static const char* modifierNames[] =
 {
@@ -639,6 +643,20 @@ void Context::staticInitialization ()
       for (auto r = values.rbegin(); r != values.rend (); ++r)
         Task::customOrder[name].push_back (*r);
     }
+
+    // Gather all UDAs with a non-empty uda.<name>.default value.
+    if (rc.first.substr (0, 4) == "uda." &&
+        rc.first.find (".default") != std::string::npos)
+    {
+      auto period = rc.first.find ('.', 4);
+      if (period != std::string::npos)
+      {
+        std::string name = rc.first.substr (4, period - 4);
+        std::string value = config.get ("uda." + name + ".default");
+        if (value != "")
+          Task::defaultUDAs[name] = value;
+      }
+    }
   }
 
   for (auto& col : columns)
@@ -647,6 +665,8 @@ void Context::staticInitialization ()
     Lexer::attributes[col.first] = col.second->type ();
   }
 
+  Task::internAttributes ();
+
   Task::urgencyProjectCoefficient     = config.getReal ("urgency.project.coefficient");
   Task::urgencyActiveCoefficient      = config.getReal ("urgency.active.coefficient");
   Task::urgencyScheduledCoefficient   = config.getReal ("urgency.scheduled.coefficient");
@@ -659,13 +679,69 @@ void Context::staticInitialization ()
   Task::urgencyAgeCoefficient         = config.getReal ("urgency.age.coefficient");
   Task::urgencyAgeMax                 = config.getReal ("urgency.age.max");
 
-  // Tag- and project-specific coefficients.
+  Task::urgencyInherit                = config.getBoolean ("urgency.inherit");
+
+  // Tag-, project-, keyword- and UDA-specific coefficients, compiled once into
+  // rules, so that urgency need not parse variable names for every task.
+  // Rules with no effect are dropped.
+  Task::urgencyUDARules.clear ();
+  Task::urgencyKeywordRules.clear ();
+  Task::urgencyProjectRules.clear ();
+  Task::urgencyTagRules.clear ();
+
   std::vector <std::string> all;
   config.all (all);
   for (auto& var : all)
-    if (var.substr (0, 13) == "urgency.user." ||
-        var.substr (0, 12) == "urgency.uda.")
-      Task::coefficients[var] = config.getReal (var);
+  {
+    auto end = var.find (".coefficient");
+    if (end == std::string::npos)
+      continue;
+
+    Task::UrgencyRule rule;
+    rule._valued = false;
+    rule._coefficient = config.getReal (var);
+    if (fabs (rule._coefficient) <= epsilon)
+      continue;
+
+    if (var.substr (0, 13) == "urgency.user.")
+    {
+      // urgency.user.project.<project>.coefficient
+      if (var.substr (13, 8) == "project.")
+      {
+        rule._name = var.substr (21, end - 21);
+        Task::urgencyProjectRules.push_back (rule);
+      }
+
+      // urgency.user.tag.<tag>.coefficient
+      else if (var.substr (13, 4) == "tag.")
+      {
+        rule._name = var.substr (17, end - 17);
+        Task::urgencyTagRules.push_back (rule);
+      }
+
+      // urgency.user.keyword.<keyword>.coefficient
+      else if (var.substr (13, 8) == "keyword.")
+      {
+        rule._name = var.substr (21, end - 21);
+        Task::urgencyKeywordRules.push_back (rule);
+      }
+    }
+    else if (var.substr (0, 12) == "urgency.uda.")
+    {
+      // urgency.uda.<name>.coefficient
+      // urgency.uda.<name>.<value>.coefficient
+      rule._name = var.substr (12, end - 12);
+      auto dot = rule._name.find (".");
+      if (dot != std::string::npos)
+      {
+        rule._value  = rule._name.substr (dot + 1);
+        rule._name   = rule._name.substr (0, dot);
+        rule._valued = true;
+      }
+
+      Task::urgencyUDARules.push_back (rule);
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
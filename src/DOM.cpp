@@ -39,6 +39,71 @@
 
 extern Context context;
 
+////////////////////////////////////////////////////////////////////////////////
+// Reduces the column type to the way its values are read from a task.
+static char attributeType (const std::string& name, Column* column)
+{
+  std::string type = column->type ();
+  if (type == "date")
+    return 'd';
+
+  if (type == "duration" || name == "recur")
+    return 'p';
+
+  if (type == "numeric")
+    return 'n';
+
+  return 's';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void attributeValue (
+  const Task& task,
+  const std::string& name,
+  char type,
+  bool uda,
+  Variant& value)
+{
+  if (uda && ! task.has (name))
+  {
+    value = Variant ("");
+    return;
+  }
+
+  if (type == 'd')
+  {
+    auto numeric = task.get_date (name);
+    if (numeric == 0)
+      value = Variant ("");
+    else
+      value = Variant (numeric, Variant::type_date);
+  }
+  else if (type == 'p')
+  {
+    auto period = task.get (name);
+
+    ISO8601p iso;
+    std::string::size_type cursor = 0;
+    if (iso.parse (period, cursor))
+      value = Variant ((time_t) iso._value, Variant::type_duration);
+    else
+      value = Variant ((time_t) ISO8601p (period), Variant::type_duration);
+  }
+  else if (type == 'n')
+    value = Variant (task.get_float (name));
+  else
+    value = Variant (task.get (name));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DOM::Ref::Ref ()
+: _kind (Kind::other)
+, _attribute ("")
+, _type ('s')
+, _uda (false)
+{
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 DOM::DOM ()
 {
@@ -205,7 +270,7 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
 
   if (task.size () && name == "urgency")
   {
-    value = Variant (task.urgency_c ());
+    value = Variant (task.recalc_urgency ? task.urgency_c () : task.urgency_value);
     return true;
   }
 
@@ -213,28 +278,33 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
   std::vector <std::string> elements;
   split (elements, name, '.');
 
-  Task ref (task);
+  // The contextual task is read in place, unless an ID or UUID names another
+  // task, which is then loaded.
+  const Task* ref = &task;
+  Task loaded;
   Nibbler n (elements[0]);
   n.save ();
   int id;
   std::string uuid;
 
-  // If elements[0] is a UUID, load that task (if necessary), and clobber ref.
+  // If elements[0] is a UUID, load that task (if necessary), and point ref at it.
   if (n.getPartialUUID (uuid) && n.depleted ())
   {
-    if (uuid != ref.get ("uuid"))
-      context.tdb2.get (uuid, ref);
+    if (uuid != task.get_ref ("uuid") &&
+        context.tdb2.get (uuid, loaded))
+      ref = &loaded;
 
     // Eat elements[0]/UUID.
     elements.erase (elements.begin ());
   }
   else
   {
-    // If elements[0] is a ID, load that task (if necessary), and clobber ref.
+    // If elements[0] is a ID, load that task (if necessary), and point ref at it.
     if (n.getInt (id) && n.depleted ())
     {
-      if (id != ref.id)
-        context.tdb2.get (id, ref);
+      if (id != task.id &&
+          context.tdb2.get (id, loaded))
+        ref = &loaded;
 
       // Eat elements[0]/ID.
       elements.erase (elements.begin ());
@@ -248,64 +318,36 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
   {
     // Now that 'ref' is the contextual task, and any ID/UUID is chopped off the
     // elements vector, DOM resolution is now simple.
-    if (ref.size () && size == 1 && canonical == "id")
+    if (ref->size () && size == 1 && canonical == "id")
     {
-      value = Variant (static_cast<int> (ref.id));
+      value = Variant (static_cast<int> (ref->id));
       return true;
     }
 
-    if (ref.size () && size == 1 && canonical == "urgency")
+    if (ref->size () && size == 1 && canonical == "urgency")
     {
-      value = Variant (ref.urgency_c ());
+      value = Variant (ref->recalc_urgency ? ref->urgency_c () : ref->urgency_value);
       return true;
     }
 
-    Column* column = context.columns[canonical];
+    auto found = context.columns.find (canonical);
+    Column* column = found != context.columns.end () ? found->second : NULL;
 
-    if (ref.size () && size == 1 && column)
+    if (ref->size () && size == 1 && column)
     {
-      if (column->is_uda () && ! ref.has (canonical))
-      {
-        value = Variant ("");
-        return true;
-      }
-
-      if (column->type () == "date")
-      {
-        auto numeric = ref.get_date (canonical);
-        if (numeric == 0)
-          value = Variant ("");
-        else
-          value = Variant (numeric, Variant::type_date);
-      }
-      else if (column->type () == "duration" || canonical == "recur")
-      {
-        auto period = ref.get (canonical);
-
-        ISO8601p iso;
-        std::string::size_type cursor = 0;
-        if (iso.parse (period, cursor))
-          value = Variant ((time_t) iso._value, Variant::type_duration);
-        else
-          value = Variant ((time_t) ISO8601p (ref.get (canonical)), Variant::type_duration);
-      }
-      else if (column->type () == "numeric")
-        value = Variant (ref.get_float (canonical));
-      else
-        value = Variant (ref.get (canonical));
-
+      attributeValue (*ref, canonical, attributeType (canonical, column), column->is_uda (), value);
       return true;
     }
 
-    if (ref.size () && size == 2 && canonical == "tags")
+    if (ref->size () && size == 2 && canonical == "tags")
     {
-      value = Variant (ref.hasTag (elements[1]) ? elements[1] : "");
+      value = Variant (ref->hasTag (elements[1]) ? elements[1] : "");
       return true;
     }
 
-    if (ref.size () && size == 2 && column && column->type () == "date")
+    if (ref->size () && size == 2 && column && column->type () == "date")
     {
-      Date date (ref.get_date (canonical));
+      Date date (ref->get_date (canonical));
            if (elements[1] == "year")    { value = Variant (static_cast<int> (date.year ()));      return true; }
       else if (elements[1] == "month")   { value = Variant (static_cast<int> (date.month ()));     return true; }
       else if (elements[1] == "day")     { value = Variant (static_cast<int> (date.day ()));       return true; }
@@ -318,10 +360,10 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
     }
   }
 
-  if (ref.size () && size == 3 && elements[0] == "annotations")
+  if (ref->size () && size == 3 && elements[0] == "annotations")
   {
     std::map <std::string, std::string> annos;
-    ref.getAnnotations (annos);
+    ref->getAnnotations (annos);
 
     int a = strtol (elements[1].c_str (), NULL, 10);
     int count = 0;
@@ -347,10 +389,10 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
     }
   }
 
-  if (ref.size () && size == 4 && elements[0] == "annotations" && elements[2] == "entry")
+  if (ref->size () && size == 4 && elements[0] == "annotations" && elements[2] == "entry")
   {
     std::map <std::string, std::string> annos;
-    ref.getAnnotations (annos);
+    ref->getAnnotations (annos);
 
     int a = strtol (elements[1].c_str (), NULL, 10);
     int count = 0;
@@ -388,3 +430,94 @@ bool DOM::get (const std::string& name, const Task& task, Variant& value)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+// Determines whether the value of a reference depends on the task, following
+// the same steps as DOM::get.  If it does, and the reference is a plain
+// attribute, id or urgency, then 'ref' is set up so that DOM::get can read it
+// directly.  Otherwise the value is that of the context-free DOM::get.
+bool DOM::resolve (const std::string& name, Ref& ref)
+{
+  ref = Ref ();
+
+  if (name == "id")
+  {
+    ref._kind = Ref::Kind::id;
+    return true;
+  }
+
+  if (name == "urgency")
+  {
+    ref._kind = Ref::Kind::urgency;
+    return true;
+  }
+
+  std::vector <std::string> elements;
+  split (elements, name, '.');
+
+  Nibbler n (elements[0]);
+  n.save ();
+  int id;
+  std::string uuid;
+
+  // Names beginning with a UUID or ID refer to another task.
+  if ((n.getPartialUUID (uuid) && n.depleted ()) ||
+      (n.getInt (id) && n.depleted ()))
+  {
+    ref._kind = Ref::Kind::indirect;
+    return true;
+  }
+
+  std::string canonical;
+  if (context.cli2.canonicalize (canonical, "attribute", elements[0]))
+  {
+    if (elements.size () == 1)
+    {
+      auto column = context.columns.find (canonical);
+
+           if (canonical == "id")      ref._kind = Ref::Kind::id;
+      else if (canonical == "urgency") ref._kind = Ref::Kind::urgency;
+      else if (column != context.columns.end () && column->second)
+      {
+        ref._kind      = Ref::Kind::attribute;
+        ref._attribute = canonical;
+        ref._type      = attributeType (canonical, column->second);
+        ref._uda       = column->second->is_uda ();
+      }
+    }
+
+    return true;
+  }
+
+  return elements[0] == "annotations" &&
+         (elements.size () == 3 || elements.size () == 4);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads a reference set up by DOM::resolve.  Returns false if the task is empty
+// or the reference is not a plain one, in which case the caller falls back to
+// looking up the name.
+bool DOM::get (const Ref& ref, const Task& task, Variant& value)
+{
+  if (! task.size ())
+    return false;
+
+  switch (ref._kind)
+  {
+  case Ref::Kind::id:
+    value = Variant (static_cast<int> (task.id));
+    return true;
+
+  case Ref::Kind::urgency:
+    // Already computed for a report, if the task was sorted by it.
+    value = Variant (task.recalc_urgency ? task.urgency_c () : task.urgency_value);
+    return true;
+
+  case Ref::Kind::attribute:
+    attributeValue (task, ref._attribute, ref._type, ref._uda, value);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -35,11 +35,28 @@
 class DOM
 {
 public:
+  // A reference resolved once, so that it may be looked up in many tasks
+  // without parsing the name again.
+  class Ref
+  {
+  public:
+    enum class Kind { other, indirect, id, urgency, attribute };
+
+    Ref ();
+
+    Kind        _kind;
+    std::string _attribute;
+    char        _type;       // d=date, p=duration, n=numeric, s=string
+    bool        _uda;
+  };
+
   DOM ();
   ~DOM ();
 
   bool get (const std::string&, Variant&);
   bool get (const std::string&, const Task&, Variant&);
+  bool resolve (const std::string&, Ref&);
+  bool get (const Ref&, const Task&, Variant&);
 
 private:
 };
@@ -198,7 +198,8 @@ std::string Date::toEpochString ()
 // 19980119T070000Z =  YYYYMMDDThhmmssZ
 std::string Date::toISO ()
 {
-  struct tm* t = gmtime (&_t);
+  struct tm parts;
+  struct tm* t = gmtime_r (&_t, &parts);
 
   std::stringstream iso;
   iso << std::setw (4) << std::setfill ('0') << t->tm_year + 1900
@@ -228,7 +229,8 @@ void Date::toEpoch (time_t& epoch)
 ////////////////////////////////////////////////////////////////////////////////
 void Date::toMDY (int& m, int& d, int& y)
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
 
   m = t->tm_mon + 1;
   d = t->tm_mday;
@@ -462,7 +464,8 @@ std::string Date::dayName (int dow)
 ////////////////////////////////////////////////////////////////////////////////
 int Date::weekOfYear (int weekStart) const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   char   weekStr[3];
 
   if (weekStart == 0)
@@ -483,7 +486,8 @@ int Date::weekOfYear (int weekStart) const
 ////////////////////////////////////////////////////////////////////////////////
 int Date::dayOfWeek () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_wday;
 }
 
@@ -508,7 +512,8 @@ int Date::dayOfWeek (const std::string& input)
 ////////////////////////////////////////////////////////////////////////////////
 int Date::dayOfYear () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_yday + 1;
 }
 
@@ -602,7 +607,8 @@ time_t Date::easter (int year)
 ////////////////////////////////////////////////////////////////////////////////
 int Date::month () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_mon + 1;
 }
 
@@ -615,35 +621,40 @@ int Date::week () const
 ////////////////////////////////////////////////////////////////////////////////
 int Date::day () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_mday;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int Date::year () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_year + 1900;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int Date::hour () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_hour;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int Date::minute () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_min;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 int Date::second () const
 {
-  struct tm* t = localtime (&_t);
+  struct tm parts;
+  struct tm* t = localtime_r (&_t, &parts);
   return t->tm_sec;
 }
 
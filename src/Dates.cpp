@@ -85,7 +85,8 @@ static void midsommar (struct tm* t)
   t->tm_isdst = -1;                       // Probably DST, but check.
 
   time_t then = mktime (t);               // Obtain the weekday of June 20th.
-  struct tm* mid = localtime (&then);
+  struct tm parts;
+  struct tm* mid = localtime_r (&then, &parts);
   t->tm_mday += 6 - mid->tm_wday;         // How many days after 20th.
 }
 
@@ -98,7 +99,8 @@ static void midsommarafton (struct tm* t)
   t->tm_isdst = -1;                       // Probably DST, but check.
 
   time_t then = mktime (t);               // Obtain the weekday of June 19th.
-  struct tm* mid = localtime (&then);
+  struct tm parts;
+  struct tm* mid = localtime_r (&then, &parts);
   t->tm_mday += 5 - mid->tm_wday;         // How many days after 19th.
 }
 
@@ -133,7 +135,8 @@ static void midsommarafton (struct tm* t)
 bool namedDates (const std::string& name, Variant& value)
 {
   time_t now = time (NULL);
-  struct tm* t = localtime (&now);
+  struct tm parts;
+  struct tm* t = localtime_r (&now, &parts);
   int i;
 
   int minimum = CLI2::minimumMatchLength;
@@ -459,7 +462,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &parts);
       t->tm_year++;
       easter (t);
     }
@@ -486,7 +489,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &parts);
       t->tm_year++;
       midsommar (t);
     }
@@ -503,7 +506,7 @@ bool namedDates (const std::string& name, Variant& value)
     // If the result is earlier this year, then recalc for next year.
     if (value < valueNow)
     {
-      t = localtime (&now);
+      t = localtime_r (&now, &parts);
       t->tm_year++;
       midsommarafton (t);
     }
@@ -35,7 +35,10 @@
 #include <i18n.h>
 
 extern Context context;
-extern Task& contextTask;
+
+// Expressions evaluated without a task see DOM references as they would in an
+// empty task.
+static const Task noTask;
 
 ////////////////////////////////////////////////////////////////////////////////
 // Supported operators, borrowed from C++, particularly the precedence.
@@ -117,11 +120,28 @@ Eval::~Eval ()
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::addSource (bool (*source)(const std::string&, Variant&))
 {
-  _sources.push_back (source);
+  _sources.push_back (Source {source, NULL});
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The DOM resolves identifiers against the task being evaluated.
+void Eval::addSource (DOM& dom)
+{
+  _sources.push_back (Source {NULL, &dom});
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::evaluateInfixExpression (const std::string& e, Variant& v) const
+{
+  evaluateInfixExpression (e, noTask, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluates 'e' with DOM references read from 'task'.
+void Eval::evaluateInfixExpression (
+  const std::string& e,
+  const Task& task,
+  Variant& v) const
 {
   // Reduce e to a vector of tokens.
   Lexer l (e);
@@ -144,7 +164,7 @@ void Eval::evaluateInfixExpression (const std::string& e, Variant& v) const
     context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
 
   // Call the postfix evaluator.
-  evaluatePostfixStack (tokens, v);
+  evaluatePostfixStack (tokens, task, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -162,7 +182,7 @@ void Eval::evaluatePostfixExpression (const std::string& e, Variant& v) const
     context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (tokens));
 
   // Call the postfix evaluator.
-  evaluatePostfixStack (tokens, v);
+  evaluatePostfixStack (tokens, noTask, v);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -190,6 +210,8 @@ void Eval::compileExpression (const std::string& e)
   infixToPostfix (_compiled);
   if (_debug)
     context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (_compiled));
+
+  compile (_compiled, _program);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -209,13 +231,44 @@ void Eval::compileExpression (
   infixToPostfix (_compiled);
   if (_debug)
     context.debug ("[1;37;42mFILTER[0m Postfix      " + dump (_compiled));
+
+  compile (_compiled, _program);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Eval::evaluateCompiledExpression (Variant& v)
+void Eval::evaluateCompiledExpression (Variant& v) const
 {
-  // Call the postfix evaluator.
-  evaluatePostfixStack (_compiled, v);
+  evaluateProgram (_program, noTask, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluates the compiled expression with DOM references read from 'task'.
+void Eval::evaluateCompiledExpression (const Task& task, Variant& v) const
+{
+  evaluateProgram (_program, task, v);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Evaluation of the compiled expression may proceed on several threads at
+// once, provided that it does not load other tasks, and does not write debug
+// output.
+bool Eval::concurrent () const
+{
+  if (_debug)
+    return false;
+
+  // Indirect references load other tasks, and inherited urgency is remembered
+  // by the tasks in pending.data, as it is computed, which only one thread may
+  // do.  Urgency is read through a resolved reference, so the kind is tested
+  // whatever the instruction.
+  for (auto& instruction : _program)
+    if ((instruction._code == Instruction::Code::identifier ||
+         instruction._code == Instruction::Code::reference)    &&
+        (instruction._ref._kind == DOM::Ref::Kind::indirect ||
+         (Task::urgencyInherit && instruction._ref._kind == DOM::Ref::Kind::urgency)))
+      return false;
+
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -250,171 +303,397 @@ std::vector <std::string> Eval::getBinaryOperators ()
 ////////////////////////////////////////////////////////////////////////////////
 void Eval::evaluatePostfixStack (
   const std::vector <std::pair <std::string, Lexer::Type>>& tokens,
+  const Task& task,
   Variant& result) const
 {
-  if (tokens.size () == 0)
-    throw std::string (STRING_EVAL_NO_EXPRESSION);
+  std::vector <Instruction> program;
+  compile (tokens, program);
+  evaluateProgram (program, task, result);
+}
 
-  // This is stack used by the postfix evaluator.
-  std::vector <Variant> values;
+////////////////////////////////////////////////////////////////////////////////
+// Translates postfix tokens into instructions, so that evaluation need not
+// compare operator strings, convert literals or search sources by name.
+void Eval::compile (
+  const std::vector <std::pair <std::string, Lexer::Type>>& tokens,
+  std::vector <Instruction>& program) const
+{
+  program.clear ();
+  program.reserve (tokens.size ());
 
   for (auto& token : tokens)
   {
-    // Unary operators.
-    if (token.second == Lexer::Type::op &&
-        token.first == "!")
-    {
-      if (values.size () < 1)
-        throw std::string (STRING_EVAL_NO_EVAL);
+    Instruction instruction;
+    instruction._code  = Instruction::Code::value;
+    instruction._token = token.first;
+    instruction._dom   = NULL;
 
-      Variant right = values.back ();
-      values.pop_back ();
-      Variant result = ! right;
-      values.push_back (result);
-      if (_debug)
-        context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", token.first, (std::string) right, (std::string) result));
+    // Operators.
+    if (token.second == Lexer::Type::op)
+    {
+      typedef Instruction::Code Code;
+      static const std::map <std::string, Code> codes =
+      {
+        {"!",        Code::op_not},
+        {"_neg_",    Code::op_neg},
+        {"_pos_",    Code::op_pos},
+        {"and",      Code::op_and},
+        {"or",       Code::op_or},
+        {"&&",       Code::op_and},
+        {"||",       Code::op_or},
+        {"<",        Code::op_lt},
+        {"<=",       Code::op_lte},
+        {">",        Code::op_gt},
+        {">=",       Code::op_gte},
+        {"==",       Code::op_eq},
+        {"!==",      Code::op_ne},
+        {"=",        Code::op_partial},
+        {"!=",       Code::op_nopartial},
+        {"+",        Code::op_add},
+        {"-",        Code::op_sub},
+        {"*",        Code::op_mul},
+        {"/",        Code::op_div},
+        {"^",        Code::op_exp},
+        {"%",        Code::op_mod},
+        {"xor",      Code::op_xor},
+        {"~",        Code::op_match},
+        {"!~",       Code::op_nomatch},
+        {"_hastag_", Code::op_hastag},
+        {"_notag_",  Code::op_notag},
+      };
+
+      auto code = codes.find (token.first);
+      instruction._code = code != codes.end () ? code->second : Code::op_unknown;
     }
-    else if (token.second == Lexer::Type::op &&
-             token.first == "_neg_")
+
+    // Literals and identifiers.
+    else
     {
-      if (values.size () < 1)
-        throw std::string (STRING_EVAL_NO_EVAL);
+      instruction._value = Variant (token.first);
+      switch (token.second)
+      {
+      case Lexer::Type::number:
+        if (Lexer::isAllDigits (token.first))
+          instruction._value.cast (Variant::type_integer);
+        else
+          instruction._value.cast (Variant::type_real);
+        break;
 
-      Variant right = values.back ();
-      values.pop_back ();
+      case Lexer::Type::dom:
+      case Lexer::Type::identifier:
+        compileIdentifier (token.first, instruction);
+        break;
 
-      Variant result (0);
-      result -= right;
-      values.push_back (result);
+      case Lexer::Type::date:
+        instruction._value.cast (Variant::type_date);
+        break;
 
-      if (_debug)
-        context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", token.first, (std::string) right, (std::string) result));
+      case Lexer::Type::duration:
+        instruction._value.cast (Variant::type_duration);
+        break;
+
+      // Nothing to do.
+      case Lexer::Type::string:
+      default:
+        break;
+      }
     }
-    else if (token.second == Lexer::Type::op &&
-             token.first == "_pos_")
+
+    program.push_back (instruction);
+  }
+
+  fold (program);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Replaces each operation whose operands are all values that do not depend on
+// the task, such as literals, named dates and other such operations, with its
+// result, so that it is evaluated once, rather than for every task.  Operations
+// that read the task, and any that fail, are left to evaluation, as is the rest
+// of a program that would not evaluate.
+void Eval::fold (std::vector <Instruction>& program) const
+{
+  typedef Instruction::Code Code;
+
+  // For each value on the stack, where its instructions start, and whether it
+  // is constant.
+  std::vector <std::pair <unsigned int, bool>> values;
+
+  std::vector <Instruction> folded;
+  folded.reserve (program.size ());
+  for (unsigned int n = 0; n < program.size (); ++n)
+  {
+    const Instruction& instruction = program[n];
+    folded.push_back (instruction);
+
+    unsigned int operands;
+    switch (instruction._code)
     {
-      // The _pos_ operator is a NOP.
-      if (_debug)
-        context.debug (format ("[{1}] eval op {2} NOP", values.size (), token.first));
+    case Code::value:
+      values.push_back (std::make_pair (folded.size () - 1, true));
+      continue;
+
+    case Code::reference:
+    case Code::identifier:
+      values.push_back (std::make_pair (folded.size () - 1, false));
+      continue;
+
+    case Code::op_not:
+    case Code::op_neg:
+    case Code::op_pos:
+      operands = 1;
+      break;
+
+    default:
+      operands = 2;
+      break;
     }
 
-    // Binary operators.
-    else if (token.second == Lexer::Type::op)
+    if (values.size () < operands)
     {
-      if (values.size () < 2)
-        throw std::string (STRING_EVAL_NO_EVAL);
+      folded.insert (folded.end (), program.begin () + n + 1, program.end ());
+      break;
+    }
 
-      Variant right = values.back ();
+    unsigned int start = values[values.size () - operands].first;
+    bool constant = instruction._code != Code::op_match   &&
+                    instruction._code != Code::op_nomatch &&
+                    instruction._code != Code::op_hastag  &&
+                    instruction._code != Code::op_notag   &&
+                    instruction._code != Code::op_unknown;
+    for (unsigned int i = 0; i < operands; ++i)
+    {
+      constant = constant && values.back ().second;
       values.pop_back ();
+    }
 
-      Variant left = values.back ();
-      values.pop_back ();
+    if (constant)
+    {
+      try
+      {
+        Instruction value;
+        value._code = Code::value;
+        value._dom  = NULL;
+        evaluateProgram (std::vector <Instruction> (folded.begin () + start, folded.end ()), noTask, value._value);
+        value._token = (std::string) value._value;
 
-      // Ordering these by anticipation frequency of use is a good idea.
-      Variant result;
-           if (token.first == "and")      result = left && right;
-      else if (token.first == "or")       result = left || right;
-      else if (token.first == "&&")       result = left && right;
-      else if (token.first == "||")       result = left || right;
-      else if (token.first == "<")        result = left < right;
-      else if (token.first == "<=")       result = left <= right;
-      else if (token.first == ">")        result = left > right;
-      else if (token.first == ">=")       result = left >= right;
-      else if (token.first == "==")       result = left.operator== (right);
-      else if (token.first == "!==")      result = left.operator!= (right);
-      else if (token.first == "=")        result = left.operator_partial (right);
-      else if (token.first == "!=")       result = left.operator_nopartial (right);
-      else if (token.first == "+")        result = left + right;
-      else if (token.first == "-")        result = left - right;
-      else if (token.first == "*")        result = left * right;
-      else if (token.first == "/")        result = left / right;
-      else if (token.first == "^")        result = left ^ right;
-      else if (token.first == "%")        result = left % right;
-      else if (token.first == "xor")      result = left.operator_xor (right);
-      else if (token.first == "~")        result = left.operator_match (right, contextTask);
-      else if (token.first == "!~")       result = left.operator_nomatch (right, contextTask);
-      else if (token.first == "_hastag_") result = left.operator_hastag (right, contextTask);
-      else if (token.first == "_notag_")  result = left.operator_notag (right, contextTask);
-      else
-        throw format (STRING_EVAL_UNSUPPORTED, token.first);
+        if (_debug)
+          context.debug (format ("Eval folded {1} instructions → '{2}'", (int) (folded.size () - start), value._token));
 
-      values.push_back (result);
+        folded.resize (start);
+        folded.push_back (value);
+      }
 
-      if (_debug)
-        context.debug (format ("Eval ↓'{1}' {2} ↓'{3}' → ↑'{4}'", (std::string) left, token.first, (std::string) right, (std::string) result));
+      catch (const std::string&)
+      {
+        constant = false;
+      }
     }
 
-    // Literals and identifiers.
+    values.push_back (std::make_pair (start, constant));
+  }
+
+  program.swap (folded);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// An identifier whose value does not depend on the task is looked up now.  One
+// that the DOM reads from the task is left for evaluation, with plain attribute
+// references resolved ahead.
+void Eval::compileIdentifier (
+  const std::string& name,
+  Instruction& instruction) const
+{
+  for (auto& source : _sources)
+  {
+    if (source._dom)
+    {
+      if (source._dom->resolve (name, instruction._ref))
+      {
+        instruction._code = instruction._ref._kind == DOM::Ref::Kind::other ||
+                            instruction._ref._kind == DOM::Ref::Kind::indirect
+                          ? Instruction::Code::identifier
+                          : Instruction::Code::reference;
+        instruction._dom = source._dom;
+        if (_debug)
+          context.debug (format ("Eval identifier '{1}' resolved per task", name));
+        return;
+      }
+
+      Variant v;
+      if (source._dom->get (name, v))
+      {
+        v.source (name);
+        instruction._value = v;
+        if (_debug)
+          context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", name, (std::string) v));
+        return;
+      }
+    }
     else
     {
-      Variant v (token.first);
-      switch (token.second)
+      Variant v;
+      if (source._fn (name, v))
       {
-      case Lexer::Type::number:
-        if (Lexer::isAllDigits (token.first))
-        {
-          v.cast (Variant::type_integer);
-          if (_debug)
-            context.debug (format ("Eval literal number ↑'{1}'", (std::string) v));
-        }
-        else
-        {
-          v.cast (Variant::type_real);
-          if (_debug)
-            context.debug (format ("Eval literal decimal ↑'{1}'", (std::string) v));
-        }
-        break;
+        instruction._value = v;
+        if (_debug)
+          context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", name, (std::string) v));
+        return;
+      }
+    }
+  }
 
-      case Lexer::Type::op:
-        throw std::string (STRING_EVAL_OP_EXPECTED);
-        break;
+  // An identifier that fails lookup is a string.
+  instruction._value.cast (Variant::type_string);
+  if (_debug)
+    context.debug (format ("Eval identifier source failed '{1}'", name));
+}
 
-      case Lexer::Type::dom:
-      case Lexer::Type::identifier:
-        {
-          bool found = false;
-          for (auto source = _sources.begin (); source != _sources.end (); ++source)
-          {
-            if ((*source) (token.first, v))
-            {
-              if (_debug)
-                context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", token.first, (std::string) v));
-              found = true;
-              break;
-            }
-          }
-
-          // An identifier that fails lookup is a string.
-          if (!found)
-          {
-            v.cast (Variant::type_string);
-            if (_debug)
-              context.debug (format ("Eval identifier source failed '{1}'", token.first));
-          }
-        }
-        break;
+////////////////////////////////////////////////////////////////////////////////
+// Looks up an identifier in each source in turn, reading DOM references from
+// the given task.
+void Eval::lookup (
+  const std::string& name,
+  const Task& task,
+  Variant& value) const
+{
+  for (auto& source : _sources)
+  {
+    if (source._dom ? source._dom->get (name, task, value)
+                    : source._fn (name, value))
+    {
+      if (source._dom)
+        value.source (name);
 
-      case Lexer::Type::date:
-        v.cast (Variant::type_date);
-        if (_debug)
-          context.debug (format ("Eval literal date ↑'{1}'", (std::string) v));
-        break;
+      if (_debug)
+        context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", name, (std::string) value));
+      return;
+    }
+  }
 
-      case Lexer::Type::duration:
-        v.cast (Variant::type_duration);
+  // An identifier that fails lookup is a string.
+  value = Variant (name);
+  value.cast (Variant::type_string);
+  if (_debug)
+    context.debug (format ("Eval identifier source failed '{1}'", name));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Eval::evaluateProgram (
+  const std::vector <Instruction>& program,
+  const Task& task,
+  Variant& result) const
+{
+  if (program.size () == 0)
+    throw std::string (STRING_EVAL_NO_EXPRESSION);
+
+  // This is stack used by the postfix evaluator.
+  std::vector <Variant> values;
+  values.reserve (program.size ());
+
+  typedef Instruction::Code Code;
+  for (auto& instruction : program)
+  {
+    switch (instruction._code)
+    {
+    // Literals and identifiers.
+    case Code::value:
+      values.push_back (instruction._value);
+      if (_debug)
+        context.debug (format ("Eval literal ↑'{1}'", (std::string) instruction._value));
+      break;
+
+    case Code::reference:
+      values.push_back (Variant ());
+      if (instruction._dom->get (instruction._ref, task, values.back ()))
+      {
+        values.back ().source (instruction._token);
         if (_debug)
-          context.debug (format ("Eval literal duration ↑'{1}'", (std::string) v));
-        break;
+          context.debug (format ("Eval identifier source '{1}' → ↑'{2}'", instruction._token, (std::string) values.back ()));
+      }
+      else
+        lookup (instruction._token, task, values.back ());
+      break;
 
-      // Nothing to do.
-      case Lexer::Type::string:
-      default:
+    case Code::identifier:
+      values.push_back (Variant ());
+      lookup (instruction._token, task, values.back ());
+      break;
+
+    // Unary operators.
+    case Code::op_not:
+    case Code::op_neg:
+      {
+        if (values.size () < 1)
+          throw std::string (STRING_EVAL_NO_EVAL);
+
+        Variant right = values.back ();
+        values.pop_back ();
+
+        Variant result (0);
+        if (instruction._code == Code::op_not)
+          result = ! right;
+        else
+          result -= right;
+
+        values.push_back (result);
         if (_debug)
-          context.debug (format ("Eval literal string ↑'{1}'", (std::string) v));
-        break;
+          context.debug (format ("Eval {1} ↓'{2}' → ↑'{3}'", instruction._token, (std::string) right, (std::string) result));
       }
+      break;
+
+    case Code::op_pos:
+      // The _pos_ operator is a NOP.
+      if (_debug)
+        context.debug (format ("[{1}] eval op {2} NOP", values.size (), instruction._token));
+      break;
 
-      values.push_back (v);
+    // Binary operators.
+    default:
+      {
+        if (values.size () < 2)
+          throw std::string (STRING_EVAL_NO_EVAL);
+
+        Variant right = values.back ();
+        values.pop_back ();
+
+        Variant left = values.back ();
+        values.pop_back ();
+
+        Variant result;
+        switch (instruction._code)
+        {
+        case Code::op_and:       result = left && right;                         break;
+        case Code::op_or:        result = left || right;                         break;
+        case Code::op_lt:        result = left < right;                          break;
+        case Code::op_lte:       result = left <= right;                         break;
+        case Code::op_gt:        result = left > right;                          break;
+        case Code::op_gte:       result = left >= right;                         break;
+        case Code::op_eq:        result = left.operator== (right);               break;
+        case Code::op_ne:        result = left.operator!= (right);               break;
+        case Code::op_partial:   result = left.operator_partial (right);         break;
+        case Code::op_nopartial: result = left.operator_nopartial (right);       break;
+        case Code::op_add:       result = left + right;                          break;
+        case Code::op_sub:       result = left - right;                          break;
+        case Code::op_mul:       result = left * right;                          break;
+        case Code::op_div:       result = left / right;                          break;
+        case Code::op_exp:       result = left ^ right;                          break;
+        case Code::op_mod:       result = left % right;                          break;
+        case Code::op_xor:       result = left.operator_xor (right);             break;
+        case Code::op_match:     result = left.operator_match (right, task);     break;
+        case Code::op_nomatch:   result = left.operator_nomatch (right, task);   break;
+        case Code::op_hastag:    result = left.operator_hastag (right, task);    break;
+        case Code::op_notag:     result = left.operator_notag (right, task);     break;
+        default:
+          throw format (STRING_EVAL_UNSUPPORTED, instruction._token);
+        }
+
+        values.push_back (result);
+
+        if (_debug)
+          context.debug (format ("Eval ↓'{1}' {2} ↓'{3}' → ↑'{4}'", (std::string) left, instruction._token, (std::string) right, (std::string) result));
+      }
+      break;
     }
   }
 
@@ -704,10 +983,11 @@ bool Eval::parsePrimitive (
     else
     {
       bool found = false;
-      for (auto source = _sources.begin (); source != _sources.end (); ++source)
+      for (auto& source : _sources)
       {
         Variant v;
-        if ((*source) (infix[i].first, v))
+        if (source._dom ? source._dom->get (infix[i].first, v)
+                        : source._fn (infix[i].first, v))
         {
           found = true;
           break;
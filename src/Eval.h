@@ -31,6 +31,7 @@
 #include <string>
 #include <Lexer.h>
 #include <Variant.h>
+#include <DOM.h>
 
 class Eval
 {
@@ -42,18 +43,57 @@ public:
   bool operator== (const Eval&); // Not implemented.
 
   void addSource (bool (*fn)(const std::string&, Variant&));
+  void addSource (DOM&);
   void evaluateInfixExpression (const std::string&, Variant&) const;
+  void evaluateInfixExpression (const std::string&, const Task&, Variant&) const;
   void evaluatePostfixExpression (const std::string&, Variant&) const;
   void compileExpression (const std::string&);
   void compileExpression (const std::vector <std::pair <std::string, Lexer::Type>>&);
-  void evaluateCompiledExpression (Variant&);
+  void evaluateCompiledExpression (Variant&) const;
+  void evaluateCompiledExpression (const Task&, Variant&) const;
+  bool concurrent () const;
   void debug (bool);
 
   static std::vector <std::string> getOperators ();
   static std::vector <std::string> getBinaryOperators ();
 
 private:
-  void evaluatePostfixStack (const std::vector <std::pair <std::string, Lexer::Type>>&, Variant&) const;
+  // A source of identifier values: either a function, or the DOM, which looks
+  // them up in the task under evaluation.
+  class Source
+  {
+  public:
+    bool (*_fn)(const std::string&, Variant&);
+    DOM*  _dom;
+  };
+
+  // One step of a compiled postfix expression.  Operators are decoded,
+  // literals converted and identifiers resolved, once, when compiled.
+  class Instruction
+  {
+  public:
+    enum class Code { value, reference, identifier,
+                      op_not, op_neg, op_pos,
+                      op_and, op_or, op_xor,
+                      op_lt, op_lte, op_gt, op_gte,
+                      op_eq, op_ne, op_partial, op_nopartial,
+                      op_add, op_sub, op_mul, op_div, op_exp, op_mod,
+                      op_match, op_nomatch, op_hastag, op_notag,
+                      op_unknown };
+
+    Code        _code;
+    std::string _token;
+    Variant     _value;
+    DOM*        _dom;
+    DOM::Ref    _ref;
+  };
+
+  void compile (const std::vector <std::pair <std::string, Lexer::Type>>&, std::vector <Instruction>&) const;
+  void compileIdentifier (const std::string&, Instruction&) const;
+  void fold (std::vector <Instruction>&) const;
+  void evaluateProgram (const std::vector <Instruction>&, const Task&, Variant&) const;
+  void lookup (const std::string&, const Task&, Variant&) const;
+  void evaluatePostfixStack (const std::vector <std::pair <std::string, Lexer::Type>>&, const Task&, Variant&) const;
   void infixToPostfix (std::vector <std::pair <std::string, Lexer::Type>>&) const;
   void infixParse (std::vector <std::pair <std::string, Lexer::Type>>&) const;
   bool parseLogical (std::vector <std::pair <std::string, Lexer::Type>>&, unsigned int &) const;
@@ -71,9 +111,10 @@ private:
   std::string dump (std::vector <std::pair <std::string, Lexer::Type>>&) const;
 
 private:
-  std::vector <bool (*)(const std::string&, Variant&)> _sources;
+  std::vector <Source> _sources;
   bool _debug;
   std::vector <std::pair <std::string, Lexer::Type>> _compiled;
+  std::vector <Instruction> _program;
 };
 
 
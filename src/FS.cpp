@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <dirent.h>
 #include <string.h>
 #include <errno.h>
@@ -214,6 +215,22 @@ bool Path::executable () const
   return access (_data.c_str (), X_OK) ? false : true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The path with all symbolic links followed, or the path as it is, if it cannot
+// be resolved.
+std::string Path::resolve () const
+{
+  std::string resolved = _data;
+  char* real = realpath (_data.c_str (), NULL);
+  if (real)
+  {
+    resolved = real;
+    free (real);
+  }
+
+  return resolved;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool Path::rename (const std::string& new_name)
 {
@@ -313,6 +330,8 @@ File::File ()
 , _fh (NULL)
 , _h (-1)
 , _locked (false)
+, _map (NULL)
+, _map_length (0)
 {
 }
 
@@ -322,6 +341,8 @@ File::File (const Path& other)
 , _fh (NULL)
 , _h (-1)
 , _locked (false)
+, _map (NULL)
+, _map_length (0)
 {
 }
 
@@ -331,6 +352,8 @@ File::File (const File& other)
 , _fh (NULL)
 , _h (-1)
 , _locked (false)
+, _map (NULL)
+, _map_length (0)
 {
 }
 
@@ -340,6 +363,8 @@ File::File (const std::string& in)
 , _fh (NULL)
 , _h (-1)
 , _locked (false)
+, _map (NULL)
+, _map_length (0)
 {
 }
 
@@ -415,6 +440,8 @@ bool File::openAndLock ()
 ////////////////////////////////////////////////////////////////////////////////
 void File::close ()
 {
+  unmap ();
+
   if (_fh)
   {
     if (_locked)
@@ -438,6 +465,21 @@ bool File::lock ()
     fl.l_pid = getpid ();
     if (fcntl (_h, F_SETLKW, &fl) == 0)
       _locked = true;
+
+    // Another process may have renamed a new file over this one, while this
+    // one waited, leaving the lock on a file that is no longer in use, in
+    // which case the new file is opened, and locked, instead.
+    struct stat held;
+    struct stat named;
+    if (_locked                            &&
+        fstat (_h, &held) == 0             &&
+        stat (_data.c_str (), &named) == 0 &&
+        (held.st_ino != named.st_ino || held.st_dev != named.st_dev))
+    {
+      close ();
+      if (open ())
+        return lock ();
+    }
   }
 
   return _locked;
@@ -494,6 +536,59 @@ void File::read (std::vector <std::string>& contents)
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Opens if necessary.  Maps the whole file read-only, and provides the address
+// and length of the contents, without copying them.  The mapping is released
+// by unmap or close, and so does not outlive the open file, or any lock held on
+// it.  An empty file is mapped as a NULL address with zero length.
+bool File::map (const char*& contents, size_t& length)
+{
+  unmap ();
+  contents = NULL;
+  length = 0;
+
+  if (!_fh)
+    open ();
+
+  if (_fh)
+  {
+    struct stat s;
+    if (fstat (_h, &s))
+      return false;
+
+    if (s.st_size == 0)
+      return true;
+
+    void* address = mmap (NULL, s.st_size, PROT_READ, MAP_PRIVATE, _h, 0);
+    if (address == MAP_FAILED)
+      return false;
+
+#ifdef MADV_SEQUENTIAL
+    madvise (address, s.st_size, MADV_SEQUENTIAL);
+#endif
+
+    _map = address;
+    _map_length = s.st_size;
+
+    contents = (const char*) _map;
+    length = _map_length;
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void File::unmap ()
+{
+  if (_map)
+  {
+    munmap (_map, _map_length);
+    _map = NULL;
+    _map_length = 0;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Opens if necessary.
 void File::write (const std::string& line)
@@ -558,6 +653,48 @@ void File::truncate ()
     ftruncate (_h, 0);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void File::flush ()
+{
+  if (_fh)
+    fflush (_fh);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Flushes, and waits until the data is on disk.  False if the file is not open.
+bool File::sync ()
+{
+  if (_fh)
+  {
+    fflush (_fh);
+    return fsync (_h) == 0;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Gives this open file the permissions of the other, and its owner and group,
+// where permitted, as a copy that replaces it should have.  False if the
+// permissions could not be set.
+bool File::adopt (const File& other)
+{
+  struct stat s;
+  if (! _fh ||
+      (other._fh ? fstat (other._h, &s) : stat (other._data.c_str (), &s)) != 0)
+    return false;
+
+  // Only root may give a file away, so failing that, the group is kept, if the
+  // user belongs to it.
+  if (fchown (_h, s.st_uid, s.st_gid) != 0 &&
+      fchown (_h, (uid_t) -1, s.st_gid) != 0)
+  {
+    // Neither could be kept, which is no reason to keep the old file.
+  }
+
+  return fchmod (_h, s.st_mode & 07777) == 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //  S_IFMT          0170000  type of file
 //         S_IFIFO  0010000  named pipe (fifo)
@@ -787,6 +924,20 @@ bool File::remove (const std::string& name)
   return unlink (expand (name).c_str ()) == 0 ? true : false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Waits until the file, or directory, is on disk, which for a directory means
+// any files just renamed in it.
+bool File::sync (const std::string& name)
+{
+  int h = ::open (expand (name).c_str (), O_RDONLY);
+  if (h == -1)
+    return false;
+
+  bool synced = fsync (h) == 0;
+  ::close (h);
+  return synced;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Directory::Directory ()
 {
@@ -56,6 +56,7 @@ public:
   bool writable () const;
   bool executable () const;
   bool rename (const std::string&);
+  std::string resolve () const;
 
   // Statics
   static std::string expand (const std::string&);
@@ -90,6 +91,9 @@ public:
   void read (std::string&);
   void read (std::vector <std::string>&);
 
+  bool map (const char*&, size_t&);
+  void unmap ();
+
   void write (const std::string&);
   void write (const std::vector <std::string>&);
 
@@ -97,6 +101,9 @@ public:
   void append (const std::vector <std::string>&);
 
   void truncate ();
+  void flush ();
+  bool sync ();
+  bool adopt (const File&);
 
   virtual mode_t mode ();
   virtual size_t size () const;
@@ -113,11 +120,14 @@ public:
   static bool append (const std::string&, const std::string&);
   static bool append (const std::string&, const std::vector <std::string>&, bool addNewlines = true);
   static bool remove (const std::string&);
+  static bool sync (const std::string&);
 
 private:
-  FILE* _fh;
-  int   _h;
-  bool  _locked;
+  FILE*  _fh;
+  int    _h;
+  bool   _locked;
+  void*  _map;
+  size_t _map_length;
 };
 
 class Directory : public File
@@ -26,6 +26,9 @@
 
 #include <cmake.h>
 #include <algorithm>
+#include <exception>
+#include <thread>
+#include <stdlib.h>
 #include <Context.h>
 #include <Eval.h>
 #include <Variant.h>
@@ -37,21 +40,112 @@
 
 extern Context context;
 
-////////////////////////////////////////////////////////////////////////////////
-// Const iterator that can be derefenced into a Task by domSource.
-static Task dummy;
-Task& contextTask = dummy;
+// Below this many tasks per thread, threads cost more than they save.
+#define MINIMUM_TASKS_PER_THREAD 1000
 
 ////////////////////////////////////////////////////////////////////////////////
-bool domSource (const std::string& identifier, Variant& value)
+// Evaluates the filter against tasks [first, last), recording matches.  An
+// exception is kept for the caller to rethrow, as threads cannot pass it on.
+static void matchChunk (
+  const Eval& eval,
+  const std::vector <Task>& tasks,
+  std::vector <char>& matches,
+  unsigned int first,
+  unsigned int last,
+  std::exception_ptr& error)
 {
-  if (context.dom.get (identifier, contextTask, value))
+  try
   {
-    value.source (identifier);
-    return true;
+    for (unsigned int i = first; i < last; ++i)
+    {
+      Variant var;
+      eval.evaluateCompiledExpression (tasks[i], var);
+      matches[i] = var.get_bool ();
+    }
   }
 
-  return false;
+  catch (...)
+  {
+    error = std::current_exception ();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the tasks that match the filter to output, in their original order.
+// Large sets are split into contiguous chunks, one per thread, with this thread
+// taking the first chunk, provided the expression may be evaluated that way.
+static void matchTasks (
+  const Eval& eval,
+  const std::vector <Task>& tasks,
+  std::vector <Task>& output)
+{
+  unsigned int count = tasks.size ();
+  unsigned int threads = 1;
+  if (eval.concurrent ())
+    threads = std::min (std::max (std::thread::hardware_concurrency (), 1u),
+                        std::max (count / MINIMUM_TASKS_PER_THREAD, 1u));
+
+  // Urgency inheritance reads pending tasks, which must therefore be loaded
+  // before the threads share them.
+  if (threads > 1)
+    context.tdb2.pending.get_tasks ();
+
+  std::vector <char> matches (count, 0);
+  unsigned int chunk = (count + threads - 1) / threads;
+  std::vector <std::exception_ptr> errors (threads);
+
+  std::vector <std::thread> workers;
+  for (unsigned int first = chunk, i = 1; first < count; first += chunk, ++i)
+    workers.push_back (std::thread (matchChunk, std::cref (eval), std::cref (tasks), std::ref (matches),
+                                    first, std::min (first + chunk, count), std::ref (errors[i])));
+
+  matchChunk (eval, tasks, matches, 0, std::min (chunk, count), errors[0]);
+
+  for (auto& worker : workers)
+    worker.join ();
+
+  // The first failure, in task order, is the one the serial loop would raise.
+  for (auto& error : errors)
+    if (error)
+      std::rethrow_exception (error);
+
+  for (unsigned int i = 0; i < count; ++i)
+    if (matches[i])
+      output.push_back (tasks[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The filter terms from the command line, as tokens for Eval to compile, and
+// as written, for the debug output.
+static void precompileFilter (
+  std::vector <std::pair <std::string, Lexer::Type>>& precompiled,
+  std::string& filterSpec)
+{
+  context.cli2.prepareFilter ();
+
+  std::stringstream spec;
+  for (auto& a : context.cli2._args)
+    if (a.hasTag ("FILTER"))
+    {
+      precompiled.push_back (std::pair <std::string, Lexer::Type> (a.getToken (), a._lextype));
+      spec << a.attribute ("raw") << " ";
+    }
+
+  filterSpec = spec.str ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static void compileFilter (
+  Eval& eval,
+  const std::vector <std::pair <std::string, Lexer::Type>>& precompiled)
+{
+  eval.addSource (context.dom);
+  eval.addSource (namedDates);
+
+  // Debug output from Eval during compilation is useful.  During evaluation
+  // it is mostly noise.
+  eval.debug (context.config.getInteger ("debug.parser") >= 3 ? true : false);
+  eval.compileExpression (precompiled);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -74,38 +168,16 @@ void Filter::subset (const std::vector <Task>& input, std::vector <Task>& output
   context.timer_filter.start ();
   _startCount = (int) input.size ();
 
-  context.cli2.prepareFilter ();
-  std::stringstream filterSpec;
-
+  std::string filterSpec;
   std::vector <std::pair <std::string, Lexer::Type>> precompiled;
-  for (auto& a : context.cli2._args)
-    if (a.hasTag ("FILTER"))
-    {
-      precompiled.push_back (std::pair <std::string, Lexer::Type> (a.getToken (), a._lextype));
-      filterSpec << a.attribute ("raw") << " ";
-    }
+  precompileFilter (precompiled, filterSpec);
 
   if (precompiled.size ())
   {
     Eval eval;
-    eval.addSource (domSource);
-    eval.addSource (namedDates);
-
-    // Debug output from Eval during compilation is useful.  During evaluation
-    // it is mostly noise.
-    eval.debug (context.config.getInteger ("debug.parser") >= 3 ? true : false);
-    eval.compileExpression (precompiled);
+    compileFilter (eval, precompiled);
 
-    for (auto& task : input)
-    {
-      // Set up context for any DOM references.
-      contextTask = task;
-
-      Variant var;
-      eval.evaluateCompiledExpression (var);
-      if (var.get_bool ())
-        output.push_back (task);
-    }
+    matchTasks (eval, input, output);
 
     eval.debug (false);
   }
@@ -114,7 +186,7 @@ void Filter::subset (const std::vector <Task>& input, std::vector <Task>& output
 
   _endCount = (int) output.size ();
   context.debug (format ("Filtered {1} tasks --> {2} tasks [list subset]", _startCount, _endCount));
-  context.debug (format ("Filter used: {1}", filterSpec.str ()));
+  context.debug (format ("Filter used: {1}", filterSpec));
   context.timer_filter.stop ();
 }
 
@@ -124,65 +196,53 @@ void Filter::subset (std::vector <Task>& output)
 {
   context.timer_filter.start ();
 
-  context.cli2.prepareFilter ();
-  std::stringstream filterSpec;
-
+  std::string filterSpec;
   std::vector <std::pair <std::string, Lexer::Type>> precompiled;
-  for (auto& a : context.cli2._args)
-    if (a.hasTag ("FILTER"))
-    {
-      precompiled.push_back (std::pair <std::string, Lexer::Type> (a.getToken (), a._lextype));
-      filterSpec << a.attribute ("raw") << " ";
-    }
+  precompileFilter (precompiled, filterSpec);
 
-  // Shortcut indicates that only pending.data needs to be loaded.
+  // Shortcut indicates that only pending.data needs to be loaded, and selection
+  // that only the tasks selected by ID or UUID were evaluated.
   bool shortcut = false;
+  bool selection = false;
 
   if (precompiled.size ())
   {
-    context.timer_filter.stop ();
-    auto pending = context.tdb2.pending.get_tasks ();
-    context.timer_filter.start ();
-    _startCount = (int) pending.size ();
-
     Eval eval;
-    eval.addSource (domSource);
-    eval.addSource (namedDates);
-
-    // Debug output from Eval during compilation is useful.  During evaluation
-    // it is mostly noise.
-    eval.debug (context.config.getInteger ("debug.parser") >= 3 ? true : false);
-    eval.compileExpression (precompiled);
+    compileFilter (eval, precompiled);
 
     output.clear ();
-    for (auto& task : pending)
-    {
-      // Set up context for any DOM references.
-      contextTask = task;
 
-      Variant var;
-      eval.evaluateCompiledExpression (var);
-      if (var.get_bool ())
-        output.push_back (task);
+    std::vector <Task> selected;
+    selection = readSelected (selected);
+    if (selection)
+    {
+      _startCount = (int) selected.size ();
+      matchTasks (eval, selected, output);
     }
-
-    shortcut = pendingOnly ();
-    if (! shortcut)
+    else
     {
       context.timer_filter.stop ();
-      auto completed = context.tdb2.completed.get_tasks ();
+      auto pending = context.tdb2.pending.get_tasks ();
       context.timer_filter.start ();
-      _startCount += (int) completed.size ();
+      _startCount = (int) pending.size ();
 
-      for (auto& task : completed)
+      matchTasks (eval, pending, output);
+
+      shortcut = pendingOnly ();
+      if (! shortcut)
       {
-        // Set up context for any DOM references.
-        contextTask = task;
+        // Read only those completed tasks that the summary cannot rule out, or
+        // failing that, all of them.
+        std::vector <Task> completed;
+        if (! readCompleted (precompiled, completed))
+        {
+          context.timer_filter.stop ();
+          completed = context.tdb2.completed.get_tasks ();
+          context.timer_filter.start ();
+          _startCount += (int) completed.size ();
+        }
 
-        Variant var;
-        eval.evaluateCompiledExpression (var);
-        if (var.get_bool ())
-          output.push_back (task);
+        matchTasks (eval, completed, output);
       }
     }
 
@@ -203,9 +263,301 @@ void Filter::subset (std::vector <Task>& output)
   }
 
   _endCount = (int) output.size ();
-  context.debug (format ("Filtered {1} tasks --> {2} tasks [{3}]", _startCount, _endCount, (shortcut ? "pending only" : "all tasks")));
-  context.debug (format ("Filter used: {1}", filterSpec.str ()));
+  context.debug (format ("Filtered {1} tasks --> {2} tasks [{3}]", _startCount, _endCount, (selection ? "selected" : shortcut ? "pending only" : "all tasks")));
+  context.debug (format ("Filter used: {1}", filterSpec));
+  context.timer_filter.stop ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Take the set of all tasks and filter into a subset, as above, except that the
+// completed tasks are represented by the tallies of completed.data, if current,
+// for commands that only count tasks.  The filter must then refer to nothing
+// but tallied attributes, named dates and literals.
+//
+// Returns false if the completed tasks are in output instead.
+bool Filter::subsetTallied (std::vector <Task>& output, std::vector <TF2Tally>& tallies)
+{
+  tallies.clear ();
+
+  std::string filterSpec;
+  std::vector <std::pair <std::string, Lexer::Type>> precompiled;
+  precompileFilter (precompiled, filterSpec);
+
+  bool usable = ! pendingOnly ();
+  for (auto& token : precompiled)
+  {
+    if (token.second == Lexer::Type::dom ||
+        token.second == Lexer::Type::identifier)
+    {
+      Variant date;
+      if (token.first != "status"  &&
+          token.first != "project" &&
+          (token.second == Lexer::Type::dom || ! namedDates (token.first, date)))
+        usable = false;
+    }
+  }
+
+  if (! usable || ! context.tdb2.completed.tallied ())
+  {
+    subset (output);
+    return false;
+  }
+
+  if (! precompiled.size ())
+    safety ();
+
+  auto& pending = context.tdb2.pending.get_tasks ();
+  context.timer_filter.start ();
+  _startCount = (int) pending.size ();
+
+  auto& all = context.tdb2.completed.get_tallies ();
+  for (auto& row : all)
+    _startCount += row._count;
+
+  output.clear ();
+  if (precompiled.size ())
+  {
+    Eval eval;
+    compileFilter (eval, precompiled);
+
+    matchTasks (eval, pending, output);
+
+    for (auto& row : all)
+    {
+      // A partial task, holding only the tallied attributes, which match for
+      // all the tasks counted.  Note that set decodes its value.
+      Task task;
+      task.set ("status", row._status);
+      if (row._project != "")
+        task.set ("project", json::encode (row._project));
+
+      Variant var;
+      eval.evaluateCompiledExpression (task, var);
+      if (var.get_bool ())
+        tallies.push_back (row);
+    }
+
+    eval.debug (false);
+  }
+  else
+  {
+    output = pending;
+    tallies = all;
+  }
+
+  _endCount = (int) output.size ();
+  for (auto& row : tallies)
+    _endCount += row._count;
+
+  context.debug (format ("Filtered {1} tasks --> {2} tasks [tallied]", _startCount, _endCount));
+  context.debug (format ("Filter used: {1}", filterSpec));
+  context.timer_filter.stop ();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// If completed.data has a current summary, then those terms of the filter that
+// refer only to summarized attributes are evaluated against the summary, so
+// that only the completed tasks that satisfy them all are read.  The terms are
+// those joined by a top-level 'and', or the whole filter if it has a top-level
+// 'or' or 'xor'.  The full filter is still applied to the tasks read.
+//
+// Returns false if completed.data must be loaded instead.
+bool Filter::readCompleted (
+  const std::vector <std::pair <std::string, Lexer::Type>>& precompiled,
+  std::vector <Task>& completed)
+{
+  if (! context.tdb2.completed.summarized ())
+    return false;
+
+  // Split into terms.
+  std::vector <std::vector <std::pair <std::string, Lexer::Type>>> terms (1);
+  int depth = 0;
+  for (auto& token : precompiled)
+  {
+    if (token.second == Lexer::Type::op)
+    {
+           if (token.first == "(") ++depth;
+      else if (token.first == ")") --depth;
+      else if (depth == 0 && (token.first == "or" || token.first == "xor"))
+      {
+        terms.assign (1, precompiled);
+        break;
+      }
+      else if (depth == 0 && token.first == "and")
+      {
+        terms.push_back (std::vector <std::pair <std::string, Lexer::Type>> ());
+        continue;
+      }
+    }
+
+    terms.back ().push_back (token);
+  }
+
+  // Keep only the terms that refer to nothing but summarized attributes, named
+  // dates and literals, and join them.
+  std::vector <std::pair <std::string, Lexer::Type>> summarized;
+  for (auto& term : terms)
+  {
+    bool usable = term.size () > 0;
+    for (auto& token : term)
+    {
+      if (token.second == Lexer::Type::dom ||
+          token.second == Lexer::Type::identifier)
+      {
+        Variant date;
+        if (token.first != "uuid"    &&
+            token.first != "status"  &&
+            token.first != "end"     &&
+            token.first != "project" &&
+            (token.second == Lexer::Type::dom || ! namedDates (token.first, date)))
+          usable = false;
+      }
+    }
+
+    if (usable)
+    {
+      if (summarized.size ())
+        summarized.push_back (std::pair <std::string, Lexer::Type> ("and", Lexer::Type::op));
+
+      summarized.push_back (std::pair <std::string, Lexer::Type> ("(", Lexer::Type::op));
+      for (auto& token : term)
+        summarized.push_back (token);
+      summarized.push_back (std::pair <std::string, Lexer::Type> (")", Lexer::Type::op));
+    }
+  }
+
+  if (! summarized.size ())
+    return false;
+
+  Eval eval;
+  eval.addSource (context.dom);
+  eval.addSource (namedDates);
+  eval.compileExpression (summarized);
+
+  std::vector <TF2Summary> records;
+  for (auto& record : context.tdb2.completed.get_summary ())
+  {
+    // A partial task, holding only the summarized attributes.  Note that set
+    // decodes its value.
+    Task task;
+    task.set ("uuid",   record._uuid);
+    task.set ("status", record._status);
+    if (record._end != "")
+      task.set ("end", record._end);
+    if (record._project != "")
+      task.set ("project", json::encode (record._project));
+
+    Variant var;
+    eval.evaluateCompiledExpression (task, var);
+    if (var.get_bool ())
+      records.push_back (record);
+  }
+
   context.timer_filter.stop ();
+  bool ok = context.tdb2.completed.read_tasks (records, completed);
+  context.timer_filter.start ();
+
+  if (ok)
+  {
+    int count = (int) context.tdb2.completed.get_summary ().size ();
+    _startCount += count;
+    context.debug (format ("Read {1} of {2} completed tasks [summary]", (int) records.size (), count));
+  }
+
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Looks up the tasks that the filter selects by ID or complete UUID, which are
+// then the only tasks it can match.  This requires the selection to be one of
+// the terms joined by 'and' at the top level of the filter, and the IDs to be
+// positive integers.
+//
+// Returns false if all tasks must be evaluated instead.
+bool Filter::readSelected (std::vector <Task>& selected)
+{
+  if (! context.cli2._id_ranges.size () &&
+      ! context.cli2._uuid_list.size ())
+    return false;
+
+  std::vector <std::string> args;
+  int clause = -1;
+  for (auto& a : context.cli2._args)
+  {
+    if (a.hasTag ("FILTER"))
+    {
+      if (a.hasTag ("ID"))
+        clause = (int) args.size ();
+
+      args.push_back (a._lextype == Lexer::Type::op ? a.attribute ("raw") : "");
+    }
+  }
+
+  if (clause == -1 ||
+      (clause > 0 && args[clause - 1] != "and"))
+    return false;
+
+  // The clause ends where its parenthesis closes, at the top level.
+  int depth = 0;
+  bool closed = false;
+  for (int i = 0; i < (int) args.size (); ++i)
+  {
+    if (args[i] == "(")
+      ++depth;
+
+    else if (args[i] == ")")
+    {
+      if (--depth == 0 && i > clause && ! closed)
+      {
+        closed = true;
+        if (i + 1 < (int) args.size () && args[i + 1] != "and")
+          return false;
+      }
+    }
+
+    else if (depth == 0 && (args[i] == "or" || args[i] == "xor"))
+      return false;
+  }
+
+  for (auto& uuid : context.cli2._uuid_list)
+    if (uuid.length () != 36)
+      return false;
+
+  for (auto& range : context.cli2._id_ranges)
+    if (range.first  == "" || ! Lexer::isAllDigits (range.first)  ||
+        range.second == "" || ! Lexer::isAllDigits (range.second) ||
+        strtol (range.first.c_str (),  NULL, 10) < 1               ||
+        strtol (range.second.c_str (), NULL, 10) < 1)
+      return false;
+
+  // IDs are numbered from one, and there are no more of them than tasks.
+  context.timer_filter.stop ();
+  int count = (int) (context.tdb2.pending.get_tasks ().size () +
+                     context.tdb2.pending._added_tasks.size ());
+
+  std::vector <std::string> uuids;
+  for (auto& range : context.cli2._id_ranges)
+  {
+    int low  = strtol (range.first.c_str (),  NULL, 10);
+    int high = strtol (range.second.c_str (), NULL, 10);
+    if (low > high)
+      std::swap (low, high);
+
+    for (int id = low; id <= high && id <= count; ++id)
+    {
+      std::string uuid = context.tdb2.pending.uuid (id);
+      if (uuid != "")
+        uuids.push_back (uuid);
+    }
+  }
+
+  for (auto& uuid : context.cli2._uuid_list)
+    uuids.push_back (uuid);
+
+  context.tdb2.get (uuids, selected);
+  context.timer_filter.start ();
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
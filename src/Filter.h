@@ -30,9 +30,9 @@
 #include <string>
 #include <vector>
 #include <Task.h>
+#include <TDB2.h>
 #include <Variant.h>
-
-bool domSource (const std::string&, Variant&);
+#include <Lexer.h>
 
 class Filter
 {
@@ -42,6 +42,7 @@ public:
 
   void subset (const std::vector <Task>&, std::vector <Task>&);
   void subset (std::vector <Task>&);
+  bool subsetTallied (std::vector <Task>&, std::vector <TF2Tally>&);
   bool hasFilter ();
   bool hasModifications ();
   bool hasMiscellaneous ();
@@ -49,6 +50,10 @@ public:
   void safety ();
   void disableSafety ();
 
+private:
+  bool readSelected (std::vector <Task>&);
+  bool readCompleted (const std::vector <std::pair <std::string, Lexer::Type>>&, std::vector <Task>&);
+
 private:
   int  _startCount;
   int  _endCount;
@@ -500,7 +500,8 @@ void ISO8601d::resolve ()
   }
 
   // Get 'now' in the relevant location.
-  struct tm* t_now = utc ? gmtime (&now) : localtime (&now);
+  struct tm parts;
+  struct tm* t_now = utc ? gmtime_r (&now, &parts) : localtime_r (&now, &parts);
 
   int seconds_now = (t_now->tm_hour * 3600) +
                     (t_now->tm_min  *   60) +
@@ -705,11 +706,16 @@ bool ISO8601p::parse (const std::string& input, std::string::size_type& start)
   // Attempt a legacy format parse next.
   n.restore ();
 
-  // Static and so preserved between calls.
-  static std::vector <std::string> units;
-  if (units.size () == 0)
+  // Static and so preserved between calls, and initialized only once, even if
+  // several threads get here first.
+  static const std::vector <std::string> units = [] ()
+  {
+    std::vector <std::string> all;
     for (unsigned int i = 0; i < NUM_DURATIONS; i++)
-      units.push_back (durations[i].unit);
+      all.push_back (durations[i].unit);
+
+    return all;
+  } ();
 
   std::string number;
   std::string unit;
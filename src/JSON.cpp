@@ -25,81 +25,323 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cmake.h>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <Lexer.h>
 #include <text.h>
 #include <i18n.h>
 #include <utf8.h>
 #include <JSON.h>
 
+namespace json
+{
+  // Parses a single buffer in one pass, moving a cursor through it, so that
+  // nothing is copied but the names and values taken from it.
+  class parser
+  {
+  public:
+    parser (const std::string&);
+
+    value* parse_value ();
+    object* parse_object ();
+    array* parse_array ();
+    string* parse_string ();
+    number* parse_number ();
+    literal* parse_literal ();
+    bool parse_pair (object*);
+    bool word (const char*);
+    bool quoted (std::string&);
+
+    void skipWS ();
+    bool skip (char);
+    char next () const;
+    bool depleted () const;
+    int cursor () const;
+
+  private:
+    const char* _input;
+    size_t      _length;
+    size_t      _cursor;
+  };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+json::parser::parser (const std::string& input)
+: _input (input.data ())
+, _length (input.length ())
+, _cursor (0)
+{
+}
+
 ////////////////////////////////////////////////////////////////////////////////
-json::value* json::value::parse (Nibbler& nibbler)
+json::value* json::parser::parse_value ()
 {
   json::value* v;
-  if ((v = json::object::parse  (nibbler)) ||
-      (v = json::array::parse   (nibbler)) ||
-      (v = json::string::parse  (nibbler)) ||
-      (v = json::number::parse  (nibbler)) ||
-      (v = json::literal::parse (nibbler)))
+  if ((v = parse_object ())  ||
+      (v = parse_array ())   ||
+      (v = parse_string ())  ||
+      (v = parse_number ())  ||
+      (v = parse_literal ()))
     return v;
 
   return NULL;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-json::jtype json::value::type ()
+json::object* json::parser::parse_object ()
 {
-  return json::j_value;
+  if (! skip ('{'))
+    return NULL;
+
+  std::unique_ptr <json::object> obj (new json::object ());
+  skipWS ();
+
+  if (parse_pair (obj.get ()))
+  {
+    skipWS ();
+    while (skip (','))
+    {
+      skipWS ();
+      if (! parse_pair (obj.get ()))
+        throw format (STRING_JSON_MISSING_VALUE, cursor ());
+
+      skipWS ();
+    }
+  }
+
+  if (! skip ('}'))
+    throw format (STRING_JSON_MISSING_BRACE, cursor ());
+
+  return obj.release ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-std::string json::value::dump () const
+// Of duplicate names, the first is kept.
+bool json::parser::parse_pair (json::object* obj)
 {
-  return "<value>";
+  std::string name;
+  if (! quoted (name))
+    return false;
+
+  skipWS ();
+  if (! skip (':'))
+    throw format (STRING_JSON_MISSING_COLON, cursor ());
+
+  skipWS ();
+  std::unique_ptr <json::value> val (parse_value ());
+  if (! val)
+    throw format (STRING_JSON_MISSING_VALUE2, cursor ());
+
+  if (obj->_data.insert (std::pair <std::string, json::value*> (name, val.get ())).second)
+    val.release ();
+
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-json::string::string (const std::string& other)
+json::array* json::parser::parse_array ()
 {
-  _data = other;
+  if (! skip ('['))
+    return NULL;
+
+  std::unique_ptr <json::array> arr (new json::array ());
+  skipWS ();
+
+  json::value* value;
+  if ((value = parse_value ()))
+  {
+    arr->_data.push_back (value);
+    skipWS ();
+    while (skip (','))
+    {
+      skipWS ();
+      if (! (value = parse_value ()))
+        throw format (STRING_JSON_MISSING_VALUE, cursor ());
+
+      arr->_data.push_back (value);
+      skipWS ();
+    }
+  }
+
+  if (! skip (']'))
+    throw format (STRING_JSON_MISSING_BRACKET, cursor ());
+
+  return arr.release ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-json::string* json::string::parse (Nibbler& nibbler)
+json::string* json::parser::parse_string ()
 {
   std::string value;
-  if (nibbler.getQuoted ('"', value, false))
+  if (! quoted (value))
+    return NULL;
+
+  json::string* s = new json::string ();
+  s->_data.swap (value);
+  return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Numbers are: [+-]? digit+ ( . digit* )? ( [eE] [+-]? digit+ )?
+json::number* json::parser::parse_number ()
+{
+  size_t i = _cursor;
+  if (i < _length && (_input[i] == '-' || _input[i] == '+'))
+    ++i;
+
+  if (i >= _length || ! Lexer::isDigit (_input[i]))
+    return NULL;
+
+  while (i < _length && Lexer::isDigit (_input[i]))
+    ++i;
+
+  if (i < _length && _input[i] == '.')
   {
-    json::string* s = new json::string ();
-    s->_data = value;
-    return s;
+    ++i;
+    while (i < _length && Lexer::isDigit (_input[i]))
+      ++i;
   }
 
-  return NULL;
+  if (i < _length && (_input[i] == 'e' || _input[i] == 'E'))
+  {
+    ++i;
+    if (i < _length && (_input[i] == '+' || _input[i] == '-'))
+      ++i;
+
+    if (i >= _length || ! Lexer::isDigit (_input[i]))
+      return NULL;
+
+    while (i < _length && Lexer::isDigit (_input[i]))
+      ++i;
+  }
+
+  json::number* n = new json::number ();
+  n->_dvalue = strtof (std::string (_input + _cursor, i - _cursor).c_str (), NULL);
+  _cursor = i;
+  return n;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-json::jtype json::string::type ()
+json::literal* json::parser::parse_literal ()
 {
-  return json::j_string;
+  json::literal::literal_value value;
+       if (word ("null"))  value = json::literal::nullvalue;
+  else if (word ("false")) value = json::literal::falsevalue;
+  else if (word ("true"))  value = json::literal::truevalue;
+  else
+    return NULL;
+
+  json::literal* l = new json::literal ();
+  l->_lvalue = value;
+  return l;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-std::string json::string::dump () const
+bool json::parser::word (const char* text)
 {
-  return std::string ("\"") + _data + "\"";
+  size_t length = strlen (text);
+  if (_length - _cursor < length ||
+      strncmp (_input + _cursor, text, length))
+    return false;
+
+  _cursor += length;
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-json::number* json::number::parse (Nibbler& nibbler)
+// Takes the text between double quotes, as is, with escapes left in place.
+bool json::parser::quoted (std::string& result)
 {
-  double d;
-  if (nibbler.getNumber (d))
+  if (_cursor >= _length || _input[_cursor] != '"')
+    return false;
+
+  for (size_t i = _cursor + 1; i < _length; ++i)
   {
-    json::number* s = new json::number ();
-    s->_dvalue = d;
-    return s;
+    if (_input[i] == '\\')
+      ++i;
+
+    else if (_input[i] == '"')
+    {
+      result.assign (_input + _cursor + 1, i - _cursor - 1);
+      _cursor = i + 1;
+      return true;
+    }
   }
 
-  return NULL;
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void json::parser::skipWS ()
+{
+  while (_cursor < _length &&
+         (_input[_cursor] == ' '  ||
+          _input[_cursor] == '\t' ||
+          _input[_cursor] == '\n' ||
+          _input[_cursor] == '\r' ||
+          _input[_cursor] == '\f'))
+    ++_cursor;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool json::parser::skip (char c)
+{
+  if (_cursor < _length && _input[_cursor] == c)
+  {
+    ++_cursor;
+    return true;
+  }
+
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+char json::parser::next () const
+{
+  return _cursor < _length ? _input[_cursor] : '\0';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool json::parser::depleted () const
+{
+  return _cursor >= _length;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int json::parser::cursor () const
+{
+  return (int) _cursor;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+json::jtype json::value::type ()
+{
+  return json::j_value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string json::value::dump () const
+{
+  return "<value>";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+json::string::string (const std::string& other)
+{
+  _data = other;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+json::jtype json::string::type ()
+{
+  return json::j_string;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string json::string::dump () const
+{
+  return std::string ("\"") + _data + "\"";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -120,31 +362,6 @@ json::number::operator double () const
   return _dvalue;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-json::literal* json::literal::parse (Nibbler& nibbler)
-{
-  if (nibbler.getLiteral ("null"))
-  {
-    json::literal* s = new json::literal ();
-    s->_lvalue = nullvalue;
-    return s;
-  }
-  else if (nibbler.getLiteral ("false"))
-  {
-    json::literal* s = new json::literal ();
-    s->_lvalue = falsevalue;
-    return s;
-  }
-  else if (nibbler.getLiteral ("true"))
-  {
-    json::literal* s = new json::literal ();
-    s->_lvalue = truevalue;
-    return s;
-  }
-
-  return NULL;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 json::jtype json::literal::type ()
 {
@@ -166,54 +383,6 @@ json::array::~array ()
     delete i;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-json::array* json::array::parse (Nibbler& nibbler)
-{
-  Nibbler n (nibbler);
-  n.skipWS ();
-  if (n.skip ('['))
-  {
-    n.skipWS ();
-
-    json::array* arr = new json::array ();
-
-    json::value* value;
-    if ((value = json::value::parse (n)))
-    {
-      arr->_data.push_back (value);
-      value = NULL; // Not a leak.  Looks like a leak.
-      n.skipWS ();
-      while (n.skip (','))
-      {
-        n.skipWS ();
-
-        if ((value = json::value::parse (n)))
-        {
-          arr->_data.push_back (value);
-          n.skipWS ();
-        }
-        else
-        {
-          delete arr;
-          throw format (STRING_JSON_MISSING_VALUE, (int) n.cursor ());
-        }
-      }
-    }
-
-    if (n.skip (']'))
-    {
-      nibbler = n;
-      return arr;
-    }
-    else
-      throw format (STRING_JSON_MISSING_BRACKET, (int) n.cursor ());
-
-    delete arr;
-  }
-
-  return NULL;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 json::jtype json::array::type ()
 {
@@ -245,85 +414,6 @@ json::object::~object ()
     delete i.second;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-json::object* json::object::parse (Nibbler& nibbler)
-{
-  Nibbler n (nibbler);
-  n.skipWS ();
-  if (n.skip ('{'))
-  {
-    n.skipWS ();
-
-    json::object* obj = new json::object ();
-
-    std::string name;
-    json::value* value;
-    if (json::object::parse_pair (n, name, value))
-    {
-      obj->_data.insert (std::pair <std::string, json::value*> (name, value));
-      value = NULL; // Not a leak.  Looks like a leak.
-
-      n.skipWS ();
-      while (n.skip (','))
-      {
-        n.skipWS ();
-
-        if (json::object::parse_pair (n, name, value))
-        {
-          obj->_data.insert (std::pair <std::string, json::value*> (name, value));
-          n.skipWS ();
-        }
-        else
-        {
-          delete obj;
-          throw format (STRING_JSON_MISSING_VALUE, (int) n.cursor ());
-        }
-      }
-    }
-
-    if (n.skip ('}'))
-    {
-      nibbler = n;
-      return obj;
-    }
-    else
-      throw format (STRING_JSON_MISSING_BRACE, (int) n.cursor ());
-
-    delete obj;
-  }
-
-  return NULL;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-bool json::object::parse_pair (
-  Nibbler& nibbler,
-  std::string& name,
-  json::value*& val)
-{
-  Nibbler n (nibbler);
-
-  if (n.getQuoted ('"', name, false))
-  {
-    n.skipWS ();
-    if (n.skip (':'))
-    {
-      n.skipWS ();
-      if ((val = json::value::parse (n)))
-      {
-        nibbler = n;
-        return true;
-      }
-      else
-        throw format (STRING_JSON_MISSING_VALUE2, (int) n.cursor ());
-    }
-    else
-      throw format (STRING_JSON_MISSING_COLON, (int) n.cursor ());
-  }
-
-  return false;
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 json::jtype json::object::type ()
 {
@@ -352,27 +442,81 @@ std::string json::object::dump () const
 ////////////////////////////////////////////////////////////////////////////////
 json::value* json::parse (const std::string& input)
 {
-  json::value* root = NULL;
-
-  Nibbler n (input);
-  n.skipWS ();
+  json::parser p (input);
+  p.skipWS ();
 
-       if (n.next () == '{') root = json::object::parse (n);
-  else if (n.next () == '[') root = json::array::parse (n);
+  json::value* root = NULL;
+       if (p.next () == '{') root = p.parse_object ();
+  else if (p.next () == '[') root = p.parse_array ();
   else
-    throw format (STRING_JSON_MISSING_OPEN, (int) n.cursor ());
+    throw format (STRING_JSON_MISSING_OPEN, p.cursor ());
 
   // Check for end condition.
-  n.skipWS ();
-  if (!n.depleted ())
+  p.skipWS ();
+  if (! p.depleted ())
   {
     delete root;
-    throw format (STRING_JSON_EXTRA_CHARACTERS, (int) n.cursor ());
+    throw format (STRING_JSON_EXTRA_CHARACTERS, p.cursor ());
   }
 
   return root;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The elements of an array are handed over as they are parsed, and so those
+// before any error in the input have been.  An object is only handed over once
+// known to be all there is.
+void json::parse (
+  const std::string& input,
+  const std::function <void (json::value*)>& callback)
+{
+  json::parser p (input);
+  p.skipWS ();
+
+  if (p.next () == '{')
+  {
+    std::unique_ptr <json::value> root (p.parse_object ());
+
+    p.skipWS ();
+    if (! p.depleted ())
+      throw format (STRING_JSON_EXTRA_CHARACTERS, p.cursor ());
+
+    callback (root.get ());
+  }
+
+  else if (p.skip ('['))
+  {
+    p.skipWS ();
+
+    std::unique_ptr <json::value> element (p.parse_value ());
+    if (element)
+    {
+      callback (element.get ());
+      p.skipWS ();
+      while (p.skip (','))
+      {
+        p.skipWS ();
+        element.reset (p.parse_value ());
+        if (! element)
+          throw format (STRING_JSON_MISSING_VALUE, p.cursor ());
+
+        callback (element.get ());
+        p.skipWS ();
+      }
+    }
+
+    if (! p.skip (']'))
+      throw format (STRING_JSON_MISSING_BRACKET, p.cursor ());
+
+    p.skipWS ();
+    if (! p.depleted ())
+      throw format (STRING_JSON_EXTRA_CHARACTERS, p.cursor ());
+  }
+
+  else
+    throw format (STRING_JSON_MISSING_OPEN, p.cursor ());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string json::encode (const std::string& input)
 {
@@ -401,10 +545,13 @@ std::string json::encode (const std::string& input)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// TODO Using a state machine would speed this up.
 std::string json::decode (const std::string& input)
 {
+  if (input.find ('\\') == std::string::npos)
+    return input;
+
   std::string output;
+  output.reserve (input.length ());
   for (unsigned int i = 0; i < input.length (); ++i)
   {
     if (input[i] == '\\')
@@ -424,7 +571,7 @@ std::string json::decode (const std::string& input)
 
       // Compose a UTF8 unicode character.
       case 'u':
-        output += utf8_character (utf8_codepoint (input.substr (++i)));
+        output += utf8_character (utf8_codepoint (input.substr (++i, 6)));
         i += 3;
         break;
 
@@ -27,6 +27,7 @@
 #ifndef INCLUDED_JSON
 #define INCLUDED_JSON
 
+#include <functional>
 #include <map>
 #include <vector>
 #include <string>
@@ -49,7 +50,6 @@ namespace json
   public:
     value () {}
     virtual ~value () {}
-    static value* parse (Nibbler&);
     virtual jtype type ();
     virtual std::string dump () const;
   };
@@ -60,7 +60,6 @@ namespace json
     string () {}
     string (const std::string&);
     ~string () {}
-    static string* parse (Nibbler&);
     jtype type ();
     std::string dump () const;
 
@@ -73,7 +72,6 @@ namespace json
   public:
     number () : _dvalue (0.0) {}
     ~number () {}
-    static number* parse (Nibbler&);
     jtype type ();
     std::string dump () const;
     operator double () const;
@@ -87,7 +85,6 @@ namespace json
   public:
     literal () : _lvalue (none) {}
     ~literal () {}
-    static literal* parse (Nibbler&);
     jtype type ();
     std::string dump () const;
 
@@ -101,7 +98,6 @@ namespace json
   public:
     array () {}
     ~array ();
-    static array* parse (Nibbler&);
     jtype type ();
     std::string dump () const;
 
@@ -114,8 +110,6 @@ namespace json
   public:
     object () {}
     ~object ();
-    static object* parse (Nibbler&);
-    static bool parse_pair (Nibbler&, std::string&, value*&);
     jtype type ();
     std::string dump () const;
 
@@ -123,8 +117,12 @@ namespace json
     std::map <std::string, value*> _data;
   };
 
-  // Parser entry point.
+  // Parser entry points.  The first returns the whole tree.  The second hands
+  // each element of a top-level array, or else the top-level object, to the
+  // callback in turn, and deletes it after, so that the whole tree is never
+  // held at once.
   value* parse (const std::string&);
+  void parse (const std::string&, const std::function <void (value*)>&);
 
   // Encode/decode for JSON entities.
   std::string encode (const std::string&);
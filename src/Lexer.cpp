@@ -1323,6 +1323,27 @@ bool Lexer::isAllDigits (const std::string& text)
   return text.find_first_not_of ("0123456789") == std::string::npos;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Matches exactly one complete UUID, with nothing before or after it.
+bool Lexer::isFullUUID (const std::string& text)
+{
+  if (text.length () != uuid_pattern.length ())
+    return false;
+
+  for (std::string::size_type i = 0; i < uuid_pattern.length (); ++i)
+  {
+    if (uuid_pattern[i] == 'x')
+    {
+      if (! isHexDigit (text[i]))
+        return false;
+    }
+    else if (uuid_pattern[i] != text[i])
+      return false;
+  }
+
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool Lexer::isDOM (const std::string& text)
 {
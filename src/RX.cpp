@@ -29,6 +29,32 @@
 #include <string.h>
 #include <RX.h>
 
+// The most compiled expressions kept for reuse, per thread.
+#define MAXIMUM_CACHED 100
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the expression compiled from the pattern, compiling it only the first
+// time it is needed on this thread.  Each thread keeps its own, because regexec
+// may lock the expression it is given, which would serialize threads that
+// share one.  The reference is valid until the next call.
+RX& RX::cached (const std::string& pattern, bool case_sensitive /* = true */)
+{
+  static thread_local std::map <std::pair <std::string, bool>, std::unique_ptr <RX>> cache;
+
+  auto key = std::make_pair (pattern, case_sensitive);
+  auto i = cache.find (key);
+  if (i != cache.end ())
+    return *i->second;
+
+  // A pattern that does not compile throws, and is not kept.
+  std::unique_ptr <RX> rx (new RX (pattern, case_sensitive));
+
+  if (cache.size () >= MAXIMUM_CACHED)
+    cache.clear ();
+
+  return *(cache[key] = std::move (rx));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 RX::RX (
   const std::string& pattern,
@@ -29,11 +29,15 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
 #include <regex.h>
 
 class RX
 {
 public:
+  static RX& cached (const std::string&, bool caseSensitive = true);
+
   RX (const std::string&, bool caseSensitive = true);
   ~RX ();
 
@@ -25,16 +25,22 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cmake.h>
+#include <cfloat>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 #include <list>
 #include <set>
+#include <thread>
+#include <exception>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <signal.h>
 #include <Context.h>
 #include <Color.h>
 #include <Date.h>
+#include <JSON.h>
 #include <i18n.h>
 #include <text.h>
 #include <util.h>
@@ -43,6 +49,90 @@
 
 extern Context context;
 
+// Fewer lines than this per thread are not worth the thread.
+#define MINIMUM_LINES_PER_THREAD 2000
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses lines [first, last) into the corresponding, default-constructed tasks.
+// Only FF4 is handled here, because that parser has no side effects, and so
+// may run on several threads at once.  Anything else is left as an empty task
+// for the caller to parse serially, which also reproduces any error.
+static void parseLines (
+  const std::vector <std::pair <const char*, size_t>>& lines,
+  std::vector <Task>& tasks,
+  unsigned int offset,
+  unsigned int first,
+  unsigned int last)
+{
+  for (unsigned int i = first; i < last; ++i)
+  {
+    if (lines[i].second && lines[i].first[0] == '[')
+    {
+      try
+      {
+        tasks[offset + i].parseFF4 (lines[i].first, lines[i].second);
+      }
+
+      catch (...)
+      {
+        tasks[offset + i].clear ();
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Splits contents into lines, without copying, as getline would: a trailing
+// newline does not start another line.
+static void splitLines (
+  const char* contents,
+  size_t length,
+  std::vector <std::pair <const char*, size_t>>& lines)
+{
+  const char* end = contents + length;
+  while (contents < end)
+  {
+    const char* eol = (const char*) memchr (contents, '\n', end - contents);
+    if (! eol)
+      eol = end;
+
+    lines.push_back (std::pair <const char*, size_t> (contents, eol - contents));
+    contents = eol + 1;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the space-delimited field at p, and advances past it.
+static std::string nextField (const char*& p, const char* end)
+{
+  const char* space = (const char*) memchr (p, ' ', end - p);
+  if (! space)
+    space = end;
+
+  std::string field (p, space - p);
+  p = space < end ? space + 1 : end;
+  return field;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the UUID of an FF4 record, found without parsing the record, or an
+// empty string.  As quotes within values are escaped, the UUID attribute is
+// the only place 'uuid:"' can follow a space or the opening bracket.
+static std::string recordUUID (const char* line, size_t length)
+{
+  const char* end = line + length;
+  for (const char* p = line;
+       (p = (const char*) memmem (p, end - p, "uuid:\"", 6)) != NULL;
+       ++p)
+  {
+    if (p > line && (p[-1] == ' ' || p[-1] == '[') &&
+        p + 6 + 36 < end && p[6 + 36] == '"')
+      return std::string (p + 6, 36);
+  }
+
+  return "";
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TF2::TF2 ()
 : _read_only (false)
@@ -51,6 +141,21 @@ TF2::TF2 ()
 , _loaded_lines (false)
 , _has_ids (false)
 , _auto_dep_scan (false)
+, _prefix_indexed (false)
+, _summary_size (0)
+, _summary_mtime (0)
+, _loaded_summary (false)
+, _summary_current (false)
+, _summary_dirty (false)
+, _tally_size (0)
+, _tally_mtime (0)
+, _loaded_tallies (false)
+, _tallies_current (false)
+, _count_tallies (false)
+, _journaling (false)
+, _journal_records (0)
+, _appended (false)
+, _rewritten (false)
 {
 }
 
@@ -73,6 +178,34 @@ void TF2::target (const std::string& f)
     _read_only = true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Names the file that summarizes this one, record by record, which allows
+// records to be read on demand instead of loading the whole file.  As with
+// target, nothing is read yet.
+void TF2::summary (const std::string& f)
+{
+  _summary_file = File (f);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Names the file that tallies the tasks of this one, by project, status and
+// month, which is kept with the summary, so that reports counting tasks need
+// not read them.
+void TF2::statistics (const std::string& f)
+{
+  _tally_file = File (f);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Names the journal, to which changes are appended as records, leaving the file
+// itself to be rewritten only when the journal is compacted.  Whether changes
+// are journaled is configurable, but an existing journal is always replayed.
+void TF2::journal (const std::string& f)
+{
+  _journal_file = File (f);
+  _journaling = context.config.getBoolean ("data.journal");
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 const std::vector <Task>& TF2::get_tasks ()
 {
@@ -98,6 +231,19 @@ bool TF2::get (int id, Task& task)
   if (! _loaded_tasks)
     load_tasks ();
 
+  // Resolve ID -> UUID -> slot.  The slot is verified, because GC may have
+  // renumbered the tasks since the mapping was made.
+  auto i = _I2U.find (id);
+  if (i != _I2U.end ())
+  {
+    int s = slot (i->second);
+    if (s != -1 && _tasks[s].id == id)
+    {
+      task = _tasks[s];
+      return true;
+    }
+  }
+
   // This is an optimization.  Since the 'id' is based on the line number of
   // pending.data file, the task in question cannot appear earlier than line
   // (id - 1) in the file.  It can, however, appear significantly later because
@@ -118,40 +264,266 @@ bool TF2::get (int id, Task& task)
 // Locate task by uuid, which may be a partial UUID.
 bool TF2::get (const std::string& uuid, Task& task)
 {
+  // Read just the one record, if the summary shows where it is.
+  if (summarized ())
+  {
+    const TF2Summary* record = find_summary (uuid);
+    if (! record)
+      return false;
+
+    std::vector <Task> tasks;
+    if (read_tasks (std::vector <TF2Summary> (1, *record), tasks))
+    {
+      task = tasks[0];
+      return true;
+    }
+  }
+
   if (! _loaded_tasks)
     load_tasks ();
 
-  for (auto& i : _tasks)
+  int s = slot (uuid);
+  if (s == -1)
   {
-    if (closeEnough (i.get ("uuid"), uuid, uuid.length ()))
+    // A partial UUID is a case-insensitive prefix, and as several tasks may
+    // share that prefix, the earliest one in the file wins.
+    if (! _prefix_indexed)
     {
-      task = i;
-      return true;
+      for (unsigned int i = 0; i < _tasks.size (); ++i)
+        _P2S.insert (std::make_pair (lowerCase (_tasks[i].get_ref ("uuid")), i));
+
+      _prefix_indexed = true;
+    }
+
+    std::string prefix = lowerCase (uuid);
+    for (auto i = _P2S.lower_bound (prefix);
+         i != _P2S.end () && i->first.compare (0, prefix.length (), prefix) == 0;
+         ++i)
+    {
+      if (s == -1 || (int) i->second < s)
+        s = i->second;
     }
   }
 
+  if (s != -1)
+  {
+    task = _tasks[s];
+    return true;
+  }
+
   return false;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Locate tasks by complete UUID, all at once, appending those found to tasks
+// in file order.  If the summary shows where they are, it is searched once for
+// all of them, and only their records are read, otherwise each is looked up in
+// the index.
+void TF2::get (
+  const std::vector <std::string>& uuids,
+  std::vector <Task>& tasks)
+{
+  if (summarized ())
+  {
+    std::set <std::string> wanted (uuids.begin (), uuids.end ());
+    std::vector <TF2Summary> records;
+    for (auto& record : _summary)
+      if (wanted.find (record._uuid) != wanted.end ())
+        records.push_back (record);
+
+    if (read_tasks (records, tasks))
+      return;
+  }
+
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  std::vector <int> slots;
+  for (auto& uuid : uuids)
+  {
+    int s = slot (uuid);
+    if (s != -1)
+      slots.push_back (s);
+  }
+
+  std::sort (slots.begin (), slots.end ());
+  slots.erase (std::unique (slots.begin (), slots.end ()), slots.end ());
+  for (auto& s : slots)
+    tasks.push_back (_tasks[s]);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool TF2::has (const std::string& uuid)
 {
+  if (summarized ())
+  {
+    for (auto& record : _summary)
+      if (record._uuid == uuid)
+        return true;
+
+    return false;
+  }
+
   if (! _loaded_tasks)
     load_tasks ();
 
-  for (auto& i : _tasks)
-    if (i.get ("uuid") == uuid)
-      return true;
+  return slot (uuid) != -1;
+}
 
-  return false;
+////////////////////////////////////////////////////////////////////////////////
+// True if the tasks are not loaded, and the summary describes the file as it
+// is, in which case records may be read individually, instead of loading the
+// whole file.
+bool TF2::summarized ()
+{
+  if (_summary_file._data == "" || _loaded_tasks || _dirty)
+    return false;
+
+  if (! _loaded_summary && _file.open ())
+  {
+    if (context.config.getBoolean ("locking"))
+      _file.lock ();
+
+    read_summary ();
+    _file.close ();
+  }
+
+  return _summary_current;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// For when the file is rewritten other than by TF2::commit, as TDB2::revert
+// does.
+void TF2::discard_summary ()
+{
+  if (_summary_file._data != "")
+    File::remove (_summary_file._data);
+
+  if (_tally_file._data != "")
+    File::remove (_tally_file._data);
+
+  _summary.clear ();
+  _loaded_summary  = true;
+  _summary_current = false;
+  _summary_dirty   = false;
+
+  clear_tallies ();
+  _loaded_tallies  = true;
+  _tallies_current = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const std::vector <TF2Summary>& TF2::get_summary ()
+{
+  return _summary;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// True if the tallies describe the tasks in the file, unmodified.  Stale
+// tallies are counted again as the tasks are loaded, which the summary allows,
+// and written with it.
+bool TF2::tallied ()
+{
+  if (_tally_file._data == "" || _dirty)
+    return false;
+
+  if (! _loaded_tallies && ! _loaded_tasks && _file.open ())
+  {
+    if (context.config.getBoolean ("locking"))
+      _file.lock ();
+
+    read_tallies ();
+    _file.close ();
+  }
+
+  if (! _tallies_current && ! _loaded_tasks)
+  {
+    _count_tallies = true;
+    load_tasks ();
+    _count_tallies = false;
+  }
+
+  return _tallies_current;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const std::vector <TF2Tally>& TF2::get_tallies ()
+{
+  return _tallies;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads and parses only the given records, in the given order.  Fails, leaving
+// tasks unchanged, if the file no longer matches its summary, in which case the
+// caller should load the file instead.
+bool TF2::read_tasks (
+  const std::vector <TF2Summary>& records,
+  std::vector <Task>& tasks)
+{
+  if (! _file.open ())
+    return false;
+
+  if (context.config.getBoolean ("locking"))
+    _file.lock ();
+
+  size_t original = tasks.size ();
+  const char* contents;
+  size_t length;
+  bool ok = _summary_current                &&
+            _summary_size  == _file.size () &&
+            _summary_mtime == _file.mtime () &&
+            _file.map (contents, length);
+
+  try
+  {
+    for (unsigned int i = 0; ok && i < records.size (); ++i)
+    {
+      ok = records[i]._offset + records[i]._length <= length;
+      if (ok)
+      {
+        const char* line = contents + records[i]._offset;
+
+        Task task;
+        if (records[i]._length && line[0] == '[')
+          task.parseFF4 (line, records[i]._length);
+        else
+          task.parse (std::string (line, records[i]._length));
+
+        // Guards against a summary that is current in name only.
+        ok = task.get ("uuid") == records[i]._uuid;
+        if (ok)
+          tasks.push_back (task);
+      }
+    }
+  }
+
+  catch (const std::string&)
+  {
+    ok = false;
+  }
+
+  _file.close ();
+
+  if (! ok)
+  {
+    _summary_current = false;
+    tasks.resize (original);
+  }
+
+  return ok;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void TF2::add_task (Task& task)
 {
   _tasks.push_back (task);           // For subsequent queries
+  index_task (_tasks.size () - 1);
   _added_tasks.push_back (task);     // For commit/synch
 
+  if (_auto_dep_scan && _loaded_tasks)
+    update_dependencies (_tasks.size () - 1, std::vector <std::string> ());
+  journal_task (task);
+
   Task::status status = task.getStatus ();
   if (task.id == 0 &&
       (status == Task::pending   ||
@@ -167,21 +539,44 @@ void TF2::add_task (Task& task)
   _dirty = true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Adds a task that GC moved here from the other file, which unlike add_task is
+// not a change to report, and is written by appending, as additions are.
+void TF2::relocate_task (const Task& task)
+{
+  _tasks.push_back (task);
+  index_task (_tasks.size () - 1);
+  _relocated_tasks.push_back (task);
+  journal_task (task);
+  _dirty = true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 bool TF2::modify_task (const Task& task)
 {
+  if (! _loaded_tasks)
+    load_tasks ();
+
   // Modify in-place.
-  std::string uuid = task.get ("uuid");
-  for (auto& i : _tasks)
+  int s = slot (task.get ("uuid"));
+  if (s != -1)
   {
-    if (i.get ("uuid") == uuid)
+    std::vector <std::string> before;
+    if (_auto_dep_scan)
     {
-      i = task;
-      _modified_tasks.push_back (task);
-      _dirty = true;
-
-      return true;
+      _tasks[s].getDependencies (before);
+      unindex_dependencies (s);
     }
+
+    _tasks[s] = task;
+    _modified_tasks.push_back (task);
+    journal_task (task);
+
+    if (_auto_dep_scan)
+      update_dependencies (s, before);
+    _dirty = true;
+
+    return true;
   }
 
   return false;
@@ -199,6 +594,7 @@ void TF2::add_line (const std::string& line)
 void TF2::clear_tasks ()
 {
   _tasks.clear ();
+  rebuild_index ();
   _dirty = true;
 }
 
@@ -209,6 +605,46 @@ void TF2::clear_lines ()
   _dirty = true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Journals the changes that replacing the tasks with the given ones makes, for
+// when they are replaced wholesale, as TDB2::gc does.
+void TF2::journal_changes (const std::vector <Task>& tasks)
+{
+  if (_journal_file._data == "")
+    return;
+
+  std::set <std::string> kept;
+  for (auto& task : tasks)
+  {
+    const std::string& uuid = task.get_ref ("uuid");
+    kept.insert (uuid);
+
+    int s = slot (uuid);
+    if (s == -1 || ! (_tasks[s] == task))
+      journal_task (task);
+  }
+
+  for (auto& task : _tasks)
+    if (kept.find (task.get_ref ("uuid")) == kept.end ())
+      journal_removal (task.get_ref ("uuid"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A task record replaces any earlier record of the same task, on replay.
+void TF2::journal_task (const Task& task)
+{
+  if (_journal_file._data != "")
+    _journal.push_back (task.composeF4 ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A removal record, which is the UUID after a '-', drops the task on replay.
+void TF2::journal_removal (const std::string& uuid)
+{
+  if (_journal_file._data != "")
+    _journal.push_back ("-" + uuid);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Top-down recomposition.
 void TF2::commit ()
@@ -216,80 +652,427 @@ void TF2::commit ()
   // The _dirty flag indicates that the file needs to be written.
   if (_dirty)
   {
+    // With a journal in use, changes are appended to it, until it holds enough
+    // records to be worth folding into the file, or until journaling is turned
+    // off, either of which rewrites the file, once the tasks are loaded.
+    bool journal = journaled ();
+    if (journal &&
+        ! (_loaded_tasks &&
+           (! _journaling ||
+            _journal_records + _journal.size () >= (size_t) context.config.getInteger ("data.journal.limit"))))
+    {
+      write_journal ();
+    }
+
     // Special case: added but no modified means just append to the file.
-    if (!_modified_tasks.size () &&
-        (_added_tasks.size () || _added_lines.size ()))
+    else if (! journal &&
+             ! _modified_tasks.size () &&
+             (_added_tasks.size () || _relocated_tasks.size () || _added_lines.size ()))
     {
       if (_file.open ())
       {
         if (context.config.getBoolean ("locking"))
           _file.lock ();
 
-        // Write out all the added tasks.
+        // The summary can only be extended if it describes the file as it is
+        // before appending.
+        bool summarizing = false;
+        if (_summary_file._data != "" && ! _added_lines.size ())
+        {
+          if (_file.size () == 0)
+          {
+            _summary.clear ();
+            summarizing = true;
+          }
+          else
+          {
+            if (! _loaded_summary)
+              read_summary ();
+
+            summarizing = _summary_current                &&
+                          _summary_size  == _file.size () &&
+                          _summary_mtime == _file.mtime ();
+          }
+        }
+
+        // Likewise the tallies, which are otherwise left stale, to be counted
+        // again when next needed.
+        bool tallying = false;
+        if (summarizing && _tally_file._data != "")
+        {
+          if (_file.size () == 0)
+          {
+            clear_tallies ();
+            _tallies_current = true;
+          }
+          else if (! _loaded_tallies)
+            read_tallies ();
+
+          tallying = _tallies_current              &&
+                     _tally_size  == _file.size () &&
+                     _tally_mtime == _file.mtime ();
+        }
+
+        _tallies_current = tallying;
+
+        // Compose all the added tasks, then those relocated by GC, then all
+        // the added lines, to be written at once.
+        std::string contents;
+        size_t offset = _file.size ();
+        auto append = [this, summarizing, tallying, &contents, &offset] (const Task& task)
+        {
+          std::string line = task.composeF4 ();
+          contents += line + "\n";
+
+          if (summarizing)
+            summarize (task, offset, line.length ());
+
+          if (tallying)
+            tally (task);
+
+          offset += line.length () + 1;
+        };
+
         for (auto& task : _added_tasks)
-          _file.append (task.composeF4 () + "\n");
+          append (task);
+
+        for (auto& task : _relocated_tasks)
+          append (task);
 
         _added_tasks.clear ();
+        _relocated_tasks.clear ();
 
-        // Write out all the added lines.
         for (auto& line : _added_lines)
-          _file.append (line);
+          contents += line;
 
         _added_lines.clear ();
-        _file.close ();
+
+        _file.append (contents);
+        _appended = true;
+
+        if (summarizing)
+        {
+          _file.flush ();
+          write_summary ();
+        }
+        else
+          _summary_current = false;
+
+        // Note: the file stays open, and locked, until finish.
         _dirty = false;
       }
     }
     else
+      rewrite ();
+  }
+
+  // A summary that was found to be stale when the file was loaded is brought
+  // up to date, provided the file is unchanged since.
+  else if (_summary_dirty)
+  {
+    if (_file.open ())
     {
-      if (_file.open ())
-      {
-        if (context.config.getBoolean ("locking"))
-          _file.lock ();
+      if (context.config.getBoolean ("locking"))
+        _file.lock ();
 
-        // Truncate the file and rewrite.
-        _file.truncate ();
+      if (_summary_size  == _file.size () &&
+          _summary_mtime == _file.mtime ())
+        write_summary ();
 
-        // Only write out _tasks, because any deltas have already been applied.
-        for (auto& task : _tasks)
-          _file.append (task.composeF4 () + "\n");
+      _file.close ();
+    }
+  }
+}
 
-        // Write out all the added lines.
-        for (auto& line : _added_lines)
-          _file.append (line);
+////////////////////////////////////////////////////////////////////////////////
+// Folds the journal into the file.  TDB2::revert uses this, as it works on the
+// lines of the file.
+void TF2::compact ()
+{
+  if (_journal_file._data != "" && _journal_file.size ())
+  {
+    if (! _loaded_tasks)
+      load_tasks ();
 
-        _added_lines.clear ();
-        _file.close ();
-        _dirty = false;
-      }
+    rewrite ();
+    sync ();
+    if (replace ())
+      File::sync (_file.parent ());
+
+    finish ();
+
+    _lines.clear ();
+    _loaded_lines = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// True if changes go to the journal, which they do when journaling is on, and
+// also when it is off, but the journal is not yet folded into the file.
+bool TF2::journaled ()
+{
+  return _journal_file._data != "" &&
+         (_journaling || _journal_file.size ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the pending journal records, all in one write.  The journal is
+// guarded by the lock on the file it belongs to.
+void TF2::write_journal ()
+{
+  if (_file.open ())
+  {
+    if (context.config.getBoolean ("locking"))
+      _file.lock ();
+
+    if (_journal_file.open ())
+    {
+      // A record left incomplete by an interrupted write is ended first, so
+      // that it cannot run into the next one.
+      std::string records;
+      const char* contents;
+      size_t length;
+      if (_journal_file.map (contents, length) &&
+          length &&
+          contents[length - 1] != '\n')
+        records = "\n";
+
+      _journal_file.unmap ();
+
+      for (auto& record : _journal)
+        records += record + "\n";
+
+      _journal_file.append (records);
+      _journal_records += _journal.size ();
+    }
+
+    // Note: both files stay open, and the file locked, until finish.
+  }
+
+  _journal.clear ();
+  _added_tasks.clear ();
+  _relocated_tasks.clear ();
+  _dirty = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rewrites the whole file from _tasks, which leaves nothing for the journal to
+// add.  The new file is written alongside, as a copy that replaces the file
+// once synced, so that a crash leaves either the old file or the new one.  If
+// no copy can be made, the file is rewritten in place, as a last resort.
+void TF2::rewrite ()
+{
+  if (_file.open ())
+  {
+    if (context.config.getBoolean ("locking"))
+      _file.lock ();
+
+    bool summarizing = _summary_file._data != "" && ! _added_lines.size ();
+    _summary.clear ();
+
+    // The tallies are counted again when next needed, as the rewritten file
+    // may even match them in size and time.
+    if (_tally_file._data != "")
+      File::remove (_tally_file._data);
+
+    clear_tallies ();
+    _loaded_tallies  = true;
+    _tallies_current = false;
+
+    // Only write out _tasks, because any deltas have already been applied.
+    std::string contents;
+    contents.reserve (_file.size ());
+
+    size_t offset = 0;
+    for (auto& task : _tasks)
+    {
+      std::string line = task.composeF4 ();
+      contents += line + "\n";
+
+      if (summarizing)
+        summarize (task, offset, line.length ());
+
+      offset += line.length () + 1;
+    }
+
+    // Write out all the added lines.
+    for (auto& line : _added_lines)
+      contents += line;
+
+    _added_lines.clear ();
+    _relocated_tasks.clear ();
+
+    // The copy is made beside the file that a symbolic link leads to, so that
+    // it replaces that file, and not the link, and is given the permissions
+    // and owner of the file it replaces.
+    _staged_target = _file.resolve ();
+    _staged_file = File (_staged_target + ".new");
+    if (_staged_file.open () &&
+        _staged_file.adopt (_file))
+    {
+      _staged_file.truncate ();
+      _staged_file.append (contents);
     }
+    else
+    {
+      _staged_file.close ();
+      if (_staged_file.exists ())
+        _staged_file.remove ();
+
+      _staged_file = File ();
+      _file.truncate ();
+      _file.append (contents);
+      _appended = true;
+    }
+
+    // The summary describes the new file, and so is written once it is in
+    // place, as is the journal emptied, as it was replayed into _tasks.
+    _summary_dirty   = summarizing;
+    _summary_current = false;
+    _rewritten       = true;
+
+    _journal.clear ();
+    _journal_records = 0;
+
+    // Note: the file stays open, and locked, until finish.
+    _dirty = false;
   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void TF2::load_tasks ()
+// Flushes whatever commit wrote to disk.  TDB2::commit does this for all the
+// files at once, before any of them is replaced.
+void TF2::sync ()
+{
+  if (_appended)
+    _file.sync ();
+
+  _staged_file.sync ();
+  _journal_file.sync ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Renames the rewritten copy over the file, if there is one.  Returns true if
+// so, in which case the directory needs syncing.
+bool TF2::replace ()
 {
-  context.timer_load.start ();
+  if (_staged_file._data == "")
+    return false;
+
+  _staged_file.close ();
+  if (! _staged_file.rename (_staged_target))
+    throw format (STRING_FILE_PERMS, _file._data);
+
+  _staged_file = File ();
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Completes a commit, once any replacement file is in place: the journal that
+// the new file makes redundant is emptied, the summary written, and the file
+// closed, which releases the lock.
+void TF2::finish ()
+{
+  if (_rewritten)
+  {
+    if (_journal_file._data != "" && _journal_file.size ())
+      _journal_file.truncate ();
+
+    if (_summary_dirty)
+      write_summary ();
+
+    _rewritten = false;
+  }
+
+  _journal_file.close ();
+  _file.close ();
+  _appended = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::load_tasks (bool timed /* = true */)
+{
+  if (timed)
+    context.timer_load.start ();
+
+  // The lines are parsed from spans, which refer either to the mapped file, or
+  // to _lines, if the file could not be mapped or the lines are already loaded.
+  std::vector <std::pair <const char*, size_t>> lines;
+  bool mapped = false;
+  const char* contents = NULL;
+  size_t file_lines = 0;
 
   if (! _loaded_lines)
   {
-    load_lines ();
+    // The file remains open, and locked, until the journal is replayed, and
+    // after that for as long as it is mapped.
+    if (_file.open ())
+    {
+      if (context.config.getBoolean ("locking"))
+        _file.lock ();
+
+      size_t length;
+      if (_file.map (contents, length))
+      {
+        mapped = true;
+        splitLines (contents, length, lines);
+        file_lines = lines.size ();
+      }
+      else
+      {
+        _file.read (_lines);
+        _loaded_lines = true;
+      }
+    }
 
     // Apply previously added lines.
     for (auto& line : _added_lines)
-      _lines.push_back (line);
+      if (mapped)
+        lines.push_back (std::pair <const char*, size_t> (line.data (), line.length ()));
+      else
+        _lines.push_back (line);
   }
 
+  if (! mapped)
+    for (auto& line : _lines)
+      lines.push_back (std::pair <const char*, size_t> (line.data (), line.length ()));
+
+  _journal_records = replay_journal (lines);
+  if (! mapped)
+    _file.close ();
+
   int line_number = 0;
   try
   {
-    // Reduce unnecessary allocations/copies.
-    _tasks.reserve (_lines.size ());
+    // Parse in place, splitting the lines into contiguous chunks, one per
+    // thread, with this thread taking the first chunk.
+    unsigned int offset = _tasks.size ();
+    unsigned int count  = lines.size ();
+    _tasks.resize (offset + count);
 
-    for (auto& line : _lines)
+    unsigned int threads = std::min (std::max (std::thread::hardware_concurrency (), 1u),
+                                     std::max (count / MINIMUM_LINES_PER_THREAD, 1u));
+    unsigned int chunk = (count + threads - 1) / threads;
+
+    std::vector <std::thread> workers;
+    for (unsigned int first = chunk; first < count; first += chunk)
+      workers.push_back (std::thread (parseLines, std::cref (lines), std::ref (_tasks),
+                                      offset, first, std::min (first + chunk, count)));
+
+    parseLines (lines, _tasks, offset, 0, std::min (chunk, count));
+
+    for (auto& worker : workers)
+      worker.join ();
+
+    // IDs are assigned in file order, as are the mappings.
+    for (unsigned int i = 0; i < count; ++i)
     {
       ++line_number;
-      Task task (line);
+      Task& task = _tasks[offset + i];
+
+      // Anything the workers could not parse is parsed here.
+      if (! task.size ())
+        task.parse (std::string (lines[i].first, lines[i].second));
 
       // Some tasks get an ID.
       if (_has_ids)
@@ -301,7 +1084,7 @@ void TF2::load_tasks ()
           task.id = context.tdb2.next_id ();
       }
 
-      _tasks.push_back (task);
+      index_task (offset + i);
 
       // Maintain mapping for ease of link/dependency resolution.
       // Note that this mapping is not restricted by the filter, and is
@@ -316,15 +1099,117 @@ void TF2::load_tasks ()
     if (_auto_dep_scan)
       dependency_scan ();
 
+    // With the file mapped, the offset of each record is known, and so the
+    // summary is rebuilt, and marked for writing if the one on disk is stale.
+    // A replayed journal moves records, which leaves the summary stale.
+    if (mapped && _summary_file._data != "" && ! _journal_records)
+    {
+      _summary_dirty = ! read_summary ();
+      _summary.clear ();
+      for (unsigned int i = 0; i < file_lines; ++i)
+        summarize (_tasks[offset + i], lines[i].first - contents, lines[i].second);
+
+      _summary_size    = _file.size ();
+      _summary_mtime   = _file.mtime ();
+      _summary_current = true;
+
+      // The tallies are counted too, if wanted, and written with the summary.
+      if (_count_tallies)
+      {
+        clear_tallies ();
+        _tallies_current = true;
+        for (unsigned int i = 0; i < file_lines; ++i)
+          tally (_tasks[offset + i]);
+
+        _tally_size    = _summary_size;
+        _tally_mtime   = _summary_mtime;
+        _summary_dirty = true;
+      }
+    }
+
     _loaded_tasks = true;
   }
 
   catch (const std::string& e)
   {
+    if (mapped)
+      _file.close ();
+
+    _journal_file.close ();
     throw e + format (STRING_TDB2_PARSE_ERROR, _file._data, line_number);
   }
 
-  context.timer_load.stop ();
+  if (mapped)
+    _file.close ();
+
+  _journal_file.close ();
+
+  if (timed)
+    context.timer_load.stop ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Applies the journal to the lines of the file, before they are parsed, and
+// returns the number of records.  A task record replaces the line of the same
+// task, or is appended if there is none, and a removal record drops the line.
+// Incomplete records, which an interrupted write leaves, are ignored.  The
+// journal remains mapped, for the lines that now refer to it, until closed.
+size_t TF2::replay_journal (std::vector <std::pair <const char*, size_t>>& lines)
+{
+  const char* contents;
+  size_t length;
+  if (_journal_file._data == ""    ||
+      ! _journal_file.size ()      ||
+      ! _journal_file.open ()      ||
+      ! _journal_file.map (contents, length))
+    return 0;
+
+  std::vector <std::pair <const char*, size_t>> records;
+  splitLines (contents, length, records);
+
+  // UUID -> line, keeping the earliest, as index_task does.
+  std::unordered_map <std::string, size_t> slots;
+  for (size_t i = 0; i < lines.size (); ++i)
+    slots.insert (std::make_pair (recordUUID (lines[i].first, lines[i].second), i));
+
+  for (auto& record : records)
+  {
+    if (record.second > 1 && record.first[0] == '-')
+    {
+      auto slot = slots.find (std::string (record.first + 1, record.second - 1));
+      if (slot != slots.end ())
+      {
+        lines[slot->second].first = NULL;
+        slots.erase (slot);
+      }
+    }
+    else if (record.second > 1        &&
+             record.first[0] == '['   &&
+             record.first[record.second - 1] == ']')
+    {
+      std::string uuid = recordUUID (record.first, record.second);
+      if (uuid != "")
+      {
+        auto slot = slots.find (uuid);
+        if (slot != slots.end ())
+          lines[slot->second] = record;
+        else
+        {
+          slots[uuid] = lines.size ();
+          lines.push_back (record);
+        }
+      }
+    }
+  }
+
+  lines.erase (std::remove_if (lines.begin (), lines.end (),
+                               [] (const std::pair <const char*, size_t>& line)
+                               {
+                                 return line.first == NULL;
+                               }),
+               lines.end ());
+
+  return records.size ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -350,7 +1235,10 @@ std::string TF2::uuid (int id)
 
     // Apply previously added tasks.
     for (auto& task : _added_tasks)
+    {
       _tasks.push_back (task);
+      index_task (_tasks.size () - 1);
+    }
   }
 
   auto i = _I2U.find (id);
@@ -369,7 +1257,10 @@ int TF2::id (const std::string& uuid)
 
     // Apply previously added tasks.
     for (auto& task : _added_tasks)
+    {
       _tasks.push_back (task);
+      index_task (_tasks.size () - 1);
+    }
   }
 
   auto i = _U2I.find (uuid);
@@ -412,47 +1303,596 @@ void TF2::clear ()
   _added_lines.clear ();
   _I2U.clear ();
   _U2I.clear ();
+  rebuild_index ();
+
+  _summary.clear ();
+  _loaded_summary  = false;
+  _summary_current = false;
+  _summary_dirty   = false;
+
+  clear_tallies ();
+  _loaded_tallies  = false;
+  _tallies_current = false;
+
+  _relocated_tasks.clear ();
+  _journal.clear ();
+  _journal_records = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// For any task that has depenencies, follow the chain of dependencies until the
-// end.  Along the way, update the Task::is_blocked and Task::is_blocking data
-// cache.
+// Recreate the UUID -> slot index, necessary whenever _tasks is replaced or
+// reordered wholesale, as TDB2::gc does.
+void TF2::rebuild_index ()
+{
+  _U2S.clear ();
+  _P2S.clear ();
+  _prefix_indexed = false;
+
+  for (unsigned int i = 0; i < _tasks.size (); ++i)
+    index_task (i);
+
+  if (_auto_dep_scan)
+    dependency_scan ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Index the tasks that depend on each task, and from that update the
+// Task::is_blocked and Task::is_blocking data cache, in time proportional to
+// the number of dependencies.
 void TF2::dependency_scan ()
 {
-  // Iterate and modify TDB2 in-place.  Don't do this at home.
-  for (auto& left : _tasks)
+  _D2S.clear ();
+  for (unsigned int i = 0; i < _tasks.size (); ++i)
+    index_dependencies (i);
+
+  for (unsigned int i = 0; i < _tasks.size (); ++i)
+    flag_dependencies (i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Record that _tasks[slot] depends on each of its dependencies.
+void TF2::index_dependencies (unsigned int slot)
+{
+  if (_tasks[slot].has ("depends"))
+  {
+    std::vector <std::string> deps;
+    _tasks[slot].getDependencies (deps);
+
+    for (auto& dep : deps)
+      _D2S[dep].push_back (slot);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Forget that _tasks[slot] depends on each of its dependencies, before it is
+// replaced.
+void TF2::unindex_dependencies (unsigned int slot)
+{
+  if (_tasks[slot].has ("depends"))
+  {
+    std::vector <std::string> deps;
+    _tasks[slot].getDependencies (deps);
+
+    for (auto& dep : deps)
+    {
+      auto i = _D2S.find (dep);
+      if (i != _D2S.end ())
+      {
+        i->second.erase (std::remove (i->second.begin (), i->second.end (), slot),
+                         i->second.end ());
+        if (i->second.empty ())
+          _D2S.erase (i);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GC may not have run yet, so a task's status is checked, not its file.
+static bool unfinished (const Task& task)
+{
+  Task::status status = task.getStatus ();
+  return status != Task::completed &&
+         status != Task::deleted;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// A task is blocked by any dependency, and blocking any dependent, provided
+// neither is completed or deleted.
+void TF2::flag_dependencies (unsigned int slot)
+{
+  Task& task = _tasks[slot];
+  bool was_blocked  = task.is_blocked;
+  bool was_blocking = task.is_blocking;
+  task.is_blocked  = false;
+  task.is_blocking = false;
+
+  if (unfinished (task))
   {
-    if (left.has ("depends"))
+    if (task.has ("depends"))
     {
       std::vector <std::string> deps;
-      left.getDependencies (deps);
+      task.getDependencies (deps);
 
       for (auto& dep : deps)
       {
-        for (auto& right : _tasks)
-        {
-          if (right.get ("uuid") == dep)
-          {
-            // GC hasn't run yet, check both tasks for their current status
-            Task::status lstatus = left.getStatus ();
-            Task::status rstatus = right.getStatus ();
-            if (lstatus != Task::completed &&
-                lstatus != Task::deleted &&
-                rstatus != Task::completed &&
-                rstatus != Task::deleted)
-            {
-              left.is_blocked = true;
-              right.is_blocking = true;
-            }
-
-            // Only want to break out of the "right" loop.
-            break;
-          }
-        }
+        int s = this->slot (dep);
+        if (s != -1 && unfinished (_tasks[s]))
+          task.is_blocked = true;
       }
     }
+
+    auto dependents = _D2S.find (task.get_ref ("uuid"));
+    if (dependents != _D2S.end ())
+      for (auto& s : dependents->second)
+        if (unfinished (_tasks[s]))
+          task.is_blocking = true;
+  }
+
+  if (task.is_blocked  != was_blocked ||
+      task.is_blocking != was_blocking)
+    task.recalc_urgency = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Brings the index, and the flags of every task it concerns, up to date with
+// a change to _tasks[slot], which depended on the given dependencies before.
+void TF2::update_dependencies (
+  unsigned int slot,
+  const std::vector <std::string>& before)
+{
+  index_dependencies (slot);
+
+  std::vector <std::string> deps (before);
+  std::vector <std::string> after;
+  _tasks[slot].getDependencies (after);
+  deps.insert (deps.end (), after.begin (), after.end ());
+
+  std::set <unsigned int> affected {slot};
+  for (auto& dep : deps)
+  {
+    int s = this->slot (dep);
+    if (s != -1)
+      affected.insert (s);
+  }
+
+  auto dependents = _D2S.find (_tasks[slot].get_ref ("uuid"));
+  if (dependents != _D2S.end ())
+    affected.insert (dependents->second.begin (), dependents->second.end ());
+
+  for (auto& s : affected)
+    flag_dependencies (s);
+
+  // Every task that the changed one depends on, directly or not, may have
+  // inherited its urgency, and so must compute it again.
+  std::vector <unsigned int> stack;
+  std::set <unsigned int> visited;
+  for (auto& dep : deps)
+  {
+    int s = this->slot (dep);
+    if (s != -1 && visited.insert (s).second)
+      stack.push_back (s);
+  }
+
+  while (! stack.empty ())
+  {
+    Task& task = _tasks[stack.back ()];
+    stack.pop_back ();
+    task.recalc_urgency = true;
+
+    std::vector <std::string> next;
+    task.getDependencies (next);
+    for (auto& dep : next)
+    {
+      int s = this->slot (dep);
+      if (s != -1 && visited.insert (s).second)
+        stack.push_back (s);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The unfinished tasks that depend on the task with the given UUID, in file
+// order.
+void TF2::get_blocked (const std::string& uuid, std::vector <Task>& blocked)
+{
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  auto dependents = _D2S.find (uuid);
+  if (dependents != _D2S.end ())
+  {
+    std::set <unsigned int> slots (dependents->second.begin (),
+                                   dependents->second.end ());
+    for (auto& s : slots)
+      if (_tasks[s].getStatus () == Task::pending ||
+          _tasks[s].getStatus () == Task::waiting)
+        blocked.push_back (_tasks[s]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The highest urgency among the pending and waiting tasks that depend on the
+// task with the given UUID, which it inherits, or FLT_MIN if there are none.
+// Each task here remembers its urgency, so first, every task that depends on
+// this one, directly or not, is settled in topological order, deepest first.
+// That way each is computed just once, and without recursion.
+float TF2::inherited_urgency (const std::string& uuid)
+{
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  auto blocked = [this] (unsigned int s)
+  {
+    return _tasks[s].getStatus () == Task::pending ||
+           _tasks[s].getStatus () == Task::waiting;
+  };
+
+  // Slot, and whether the tasks that depend on it are already on the stack.
+  std::vector <std::pair <unsigned int, bool>> stack;
+  std::set <unsigned int> visited;
+  auto push = [&] (const std::string& uuid)
+  {
+    auto dependents = _D2S.find (uuid);
+    if (dependents != _D2S.end ())
+      for (auto& s : dependents->second)
+        if (blocked (s)                &&
+            _tasks[s].recalc_urgency   &&
+            visited.insert (s).second)
+          stack.push_back (std::make_pair (s, false));
+  };
+
+  push (uuid);
+  while (! stack.empty ())
+  {
+    unsigned int s = stack.back ().first;
+    if (! stack.back ().second)
+    {
+      stack.back ().second = true;
+      push (_tasks[s].get_ref ("uuid"));
+    }
+    else
+    {
+      stack.pop_back ();
+      _tasks[s].urgency ();
+    }
+  }
+
+  float v = FLT_MIN;
+  auto dependents = _D2S.find (uuid);
+  if (dependents != _D2S.end ())
+    for (auto& s : dependents->second)
+      if (blocked (s))
+        v = std::max (v, _tasks[s].urgency ());
+
+  return v;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The unfinished tasks that the given task depends on, in file order.
+void TF2::get_blocking (const Task& task, std::vector <Task>& blocking)
+{
+  if (! task.has ("depends"))
+    return;
+
+  if (! _loaded_tasks)
+    load_tasks ();
+
+  std::vector <std::string> deps;
+  task.getDependencies (deps);
+
+  std::set <unsigned int> slots;
+  for (auto& dep : deps)
+  {
+    int s = slot (dep);
+    if (s != -1)
+      slots.insert (s);
+  }
+
+  for (auto& s : slots)
+    if (_tasks[s].getStatus () == Task::pending ||
+        _tasks[s].getStatus () == Task::waiting)
+      blocking.push_back (_tasks[s]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Record the location of _tasks[slot].  Should the same UUID appear more than
+// once, the earliest slot is kept, as that is what a scan would find.
+void TF2::index_task (unsigned int slot)
+{
+  const std::string& uuid = _tasks[slot].get_ref ("uuid");
+  _U2S.insert (std::make_pair (uuid, slot));
+
+  if (_prefix_indexed)
+  {
+    auto i = _P2S.insert (std::make_pair (lowerCase (uuid), slot));
+    if (! i.second && i.first->second > slot)
+      i.first->second = slot;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the _tasks slot of the task with exactly the given UUID, or -1.
+int TF2::slot (const std::string& uuid)
+{
+  auto i = _U2S.find (uuid);
+  if (i != _U2S.end ())
+    return i->second;
+
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Locate a summarized record by uuid, which may be a partial UUID, in which
+// case the earliest one in the file wins, as it does for TF2::get.
+const TF2Summary* TF2::find_summary (const std::string& uuid)
+{
+  const TF2Summary* found = NULL;
+  for (auto& record : _summary)
+  {
+    if (record._uuid == uuid)
+      return &record;
+
+    if (! found &&
+        strncasecmp (record._uuid.c_str (), uuid.c_str (), uuid.length ()) == 0)
+      found = &record;
+  }
+
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the summary, which is only current if it describes the file as it is
+// now.  The caller holds the file open, and locked.
+//
+// Format:
+//   <file size> <file mtime>
+//   <offset> <length> <uuid> <status> <end|-> <JSON-encoded project>
+//   ...
+bool TF2::read_summary ()
+{
+  _loaded_summary  = true;
+  _summary_current = false;
+  _summary.clear ();
+
+  std::string contents;
+  if (! File::read (_summary_file._data, contents))
+    return false;
+
+  std::vector <std::pair <const char*, size_t>> lines;
+  splitLines (contents.data (), contents.length (), lines);
+  if (! lines.size ())
+    return false;
+
+  char* next;
+  _summary_size  = strtoul (lines[0].first, &next, 10);
+  _summary_mtime = strtol (next, &next, 10);
+  if (_summary_size  != _file.size () ||
+      _summary_mtime != _file.mtime ())
+    return false;
+
+  _summary.reserve (lines.size () - 1);
+  for (unsigned int i = 1; i < lines.size (); ++i)
+  {
+    const char* p   = lines[i].first;
+    const char* end = p + lines[i].second;
+
+    TF2Summary record;
+    record._offset  = strtoul (nextField (p, end).c_str (), NULL, 10);
+    record._length  = strtoul (nextField (p, end).c_str (), NULL, 10);
+    record._uuid    = nextField (p, end);
+    record._status  = nextField (p, end);
+    record._end     = nextField (p, end);
+    record._project = json::decode (std::string (p, end - p));
+
+    if (record._uuid == "" || record._status == "")
+    {
+      _summary.clear ();
+      return false;
+    }
+
+    if (record._end == "-")
+      record._end = "";
+
+    _summary.push_back (record);
+  }
+
+  _summary_current = true;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writes the summary, describing the file as it is now.  The caller holds the
+// file open, and locked, with everything written.
+void TF2::write_summary ()
+{
+  _summary_size  = _file.size ();
+  _summary_mtime = _file.mtime ();
+
+  std::stringstream out;
+  out << _summary_size << ' ' << _summary_mtime << '\n';
+
+  for (auto& record : _summary)
+    out << record._offset
+        << ' '
+        << record._length
+        << ' '
+        << record._uuid
+        << ' '
+        << record._status
+        << ' '
+        << (record._end != "" ? record._end : "-")
+        << ' '
+        << json::encode (record._project)
+        << '\n';
+
+  File::write (_summary_file._data, out.str ());
+
+  _loaded_summary  = true;
+  _summary_current = true;
+  _summary_dirty   = false;
+
+  if (_tally_file._data != "" && _tallies_current)
+    write_tallies ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::summarize (const Task& task, size_t offset, size_t length)
+{
+  TF2Summary record;
+  record._uuid    = task.get ("uuid");
+  record._status  = task.get ("status");
+  record._end     = task.get ("end");
+  record._project = task.get ("project");
+  record._offset  = offset;
+  record._length  = length;
+  _summary.push_back (record);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Months are counted in local time, and so tallies counted in another time zone
+// are stale.
+static std::string tallyZone ()
+{
+  tzset ();
+  return format ("{1},{2},{3}", tzname[0], tzname[1], (long long) timezone);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static std::string tallyKey (const TF2Tally& row)
+{
+  return std::to_string (row._entry) + ' ' + std::to_string (row._end) + ' ' +
+         row._status + ' ' + row._project;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reads the tallies, which are only current if they describe the file as it is
+// now.  The caller holds the file open, and locked.
+//
+// Format:
+//   <file size> <file mtime> <time zone>
+//   <entry month> <end month> <status> <count> <age> <JSON-encoded project>
+//   ...
+bool TF2::read_tallies ()
+{
+  _loaded_tallies  = true;
+  _tallies_current = false;
+  clear_tallies ();
+
+  std::string contents;
+  if (! File::read (_tally_file._data, contents))
+    return false;
+
+  std::vector <std::pair <const char*, size_t>> lines;
+  splitLines (contents.data (), contents.length (), lines);
+  if (! lines.size ())
+    return false;
+
+  const char* p   = lines[0].first;
+  const char* end = p + lines[0].second;
+  _tally_size  = strtoul (nextField (p, end).c_str (), NULL, 10);
+  _tally_mtime = strtol (nextField (p, end).c_str (), NULL, 10);
+  if (_tally_size  != _file.size ()  ||
+      _tally_mtime != _file.mtime () ||
+      std::string (p, end - p) != tallyZone ())
+    return false;
+
+  _tallies.reserve (lines.size () - 1);
+  for (unsigned int i = 1; i < lines.size (); ++i)
+  {
+    p   = lines[i].first;
+    end = p + lines[i].second;
+
+    TF2Tally row;
+    row._entry   = strtol (nextField (p, end).c_str (), NULL, 10);
+    row._end     = strtol (nextField (p, end).c_str (), NULL, 10);
+    row._status  = nextField (p, end);
+    row._count   = strtol (nextField (p, end).c_str (), NULL, 10);
+    row._age     = strtoll (nextField (p, end).c_str (), NULL, 10);
+    row._project = json::decode (std::string (p, end - p));
+
+    if (row._status == "" || row._count <= 0)
+    {
+      clear_tallies ();
+      return false;
+    }
+
+    _tally_slots[tallyKey (row)] = _tallies.size ();
+    _tallies.push_back (row);
+  }
+
+  _tallies_current = true;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writes the tallies, describing the file as it is now, as write_summary does.
+void TF2::write_tallies ()
+{
+  _tally_size  = _file.size ();
+  _tally_mtime = _file.mtime ();
+
+  std::stringstream out;
+  out << _tally_size << ' ' << _tally_mtime << ' ' << tallyZone () << '\n';
+
+  for (auto& row : _tallies)
+    out << row._entry
+        << ' '
+        << row._end
+        << ' '
+        << row._status
+        << ' '
+        << row._count
+        << ' '
+        << row._age
+        << ' '
+        << json::encode (row._project)
+        << '\n';
+
+  File::write (_tally_file._data, out.str ());
+  _loaded_tallies = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TF2::clear_tallies ()
+{
+  _tallies.clear ();
+  _tally_slots.clear ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Counts a task into the tallies.  Only completed and deleted tasks are
+// tallied, as those are all that completed.data holds, and so any other task
+// leaves the tallies incomplete.
+void TF2::tally (const Task& task)
+{
+  Task::status status = task.getStatus ();
+  if (status != Task::completed &&
+      status != Task::deleted)
+  {
+    _tallies_current = false;
+    return;
   }
+
+  time_t entry = task.get_date ("entry");
+  time_t end   = task.get_date ("end");
+
+  TF2Tally row;
+  row._project = task.get ("project");
+  row._status  = Task::statusToText (status);
+  row._entry   = Date (entry).startOfMonth ().toEpoch ();
+  row._end     = task.has ("end") ? Date (end).startOfMonth ().toEpoch () : 0;
+  row._count   = 0;
+  row._age     = 0;
+
+  auto slot = _tally_slots.insert (std::make_pair (tallyKey (row), (unsigned int) _tallies.size ()));
+  if (slot.second)
+    _tallies.push_back (row);
+
+  TF2Tally& tallied = _tallies[slot.first->second];
+  ++tallied._count;
+  if (entry && end)
+    tallied._age += end - entry;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -498,6 +1938,47 @@ const std::string TF2::dump ()
   return std::string (buffer);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+size_t TDB2Snapshot::size () const
+{
+  return _status.size ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool TDB2Snapshot::has_tag (size_t row, unsigned int tag) const
+{
+  return (_tags[row * _tag_words + tag / 64] >> (tag % 64)) & 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int TDB2Snapshot::tag_count (size_t row) const
+{
+  unsigned int count = 0;
+  for (size_t w = row * _tag_words; w < (row + 1) * _tag_words; ++w)
+    count += __builtin_popcountll (_tags[w]);
+
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void TDB2Snapshot::clear ()
+{
+  _status.clear ();
+  _entry.clear ();
+  _end.clear ();
+  _start.clear ();
+  _due.clear ();
+  _project.clear ();
+  _tags.clear ();
+  _blocked.clear ();
+  _blocking.clear ();
+  _annotations.clear ();
+  _description_length.clear ();
+  _projects.clear ();
+  _tag_names.clear ();
+  _tag_words = 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TDB2::TDB2 ()
 : _location ("")
@@ -526,7 +2007,10 @@ void TDB2::set_location (const std::string& location)
   _location = location;
 
   pending.target   (location + "/pending.data");
+  pending.journal  (location + "/pending.journal");
   completed.target (location + "/completed.data");
+  completed.summary (location + "/completed.index");
+  completed.statistics (location + "/completed.stats");
   undo.target      (location + "/undo.data");
   backlog.target   (location + "/backlog.data");
 }
@@ -655,6 +2139,25 @@ void TDB2::commit ()
   undo.commit ();
   backlog.commit ();
 
+  // Everything written is synced to disk in one batch, and only then do the
+  // rewritten files replace the originals, while all of them remain locked.
+  pending.sync ();
+  completed.sync ();
+  undo.sync ();
+  backlog.sync ();
+
+  bool replaced = pending.replace ();
+  replaced = completed.replace () || replaced;
+  replaced = undo.replace ()      || replaced;
+  replaced = backlog.replace ()   || replaced;
+  if (replaced)
+    File::sync (_location);
+
+  pending.finish ();
+  completed.finish ();
+  undo.finish ();
+  backlog.finish ();
+
   // Restore signal handling.
   signal (SIGHUP,    SIG_DFL);
   signal (SIGINT,    SIG_DFL);
@@ -740,7 +2243,8 @@ void TDB2::revert ()
     //   - erase from completed
     //   - if in backlog, erase, else cannot undo
 
-    // Modify other data files accordingly.
+    // Modify other data files accordingly, with anything journaled folded in.
+    pending.compact ();
     std::vector <std::string> p = pending.get_lines ();
     revert_pending (p, uuid, current, prior);
 
@@ -756,6 +2260,9 @@ void TDB2::revert ()
     File::write (pending._file._data, p);
     File::write (completed._file._data, c);
     File::write (backlog._file._data, b);
+
+    // The summary no longer describes completed.data.
+    completed.discard_summary ();
   }
   else
     std::cout << STRING_CMD_CONFIG_NO_CHANGE << "\n";
@@ -960,11 +2467,11 @@ void TDB2::show_diff (
       Task before (prior);
 
       std::vector <std::string> beforeAtts;
-      for (auto& att : before)
+      for (auto att : before)
         beforeAtts.push_back (att.first);
 
       std::vector <std::string> afterAtts;
-      for (auto& att : after)
+      for (auto att : after)
         afterAtts.push_back (att.first);
 
       std::vector <std::string> beforeOnly;
@@ -979,7 +2486,7 @@ void TDB2::show_diff (
         view.set (row, 1, renderAttribute (name, before.get (name)), color_red);
       }
 
-      for (auto& att : before)
+      for (auto att : before)
       {
         std::string priorValue   = before.get (att.first);
         std::string currentValue = after.get  (att.first);
@@ -1005,7 +2512,7 @@ void TDB2::show_diff (
     else
     {
       int row;
-      for (auto& att : after)
+      for (auto att : after)
       {
         row = view.addRow ();
         view.set (row, 0, att.first);
@@ -1063,11 +2570,11 @@ void TDB2::show_diff (
     std::vector <std::string> all = context.getColumns ();
 
     // Now factor in the annotation attributes.
-    for (auto& it : before)
+    for (auto it : before)
       if (it.first.substr (0, 11) == "annotation_")
         all.push_back (it.first);
 
-    for (auto& it : after)
+    for (auto it : after)
       if (it.first.substr (0, 11) == "annotation_")
         all.push_back (it.first);
 
@@ -1158,18 +2665,72 @@ int TDB2::gc ()
   // Allowed as an override, but not recommended.
   if (context.config.getBoolean ("gc"))
   {
-    auto pending_tasks = pending.get_tasks ();
+    // completed.data need only be scanned if it holds tasks that belong in
+    // pending.data, which a current summary shows without loading it.
+    bool scan_completed = true;
+    if (completed.summarized ())
+    {
+      scan_completed = false;
+      for (auto& record : completed.get_summary ())
+        if (record._status == "pending"   ||
+            record._status == "recurring" ||
+            record._status == "waiting")
+          scan_completed = true;
+    }
+
+    // Load completed.data on a separate thread, while pending.data is loaded
+    // on this one.  The load timer covers both.
+    context.timer_load.start ();
+
+    std::exception_ptr completed_error;
+    std::thread completed_loader;
+    if (scan_completed && ! completed._loaded_tasks)
+      completed_loader = std::thread ([this, &completed_error] ()
+      {
+        try
+        {
+          completed.load_tasks (false);
+        }
+
+        catch (...)
+        {
+          completed_error = std::current_exception ();
+        }
+      });
+
+    std::exception_ptr pending_error;
+    try
+    {
+      if (! pending._loaded_tasks)
+        pending.load_tasks (false);
+    }
 
-    // TODO Thread.
-    auto completed_tasks = completed.get_tasks ();
+    catch (...)
+    {
+      pending_error = std::current_exception ();
+    }
+
+    if (completed_loader.joinable ())
+      completed_loader.join ();
+
+    context.timer_load.stop ();
 
-    // TODO Assume pending < completed, therefore there is room here to process
-    //      data before joining with the completed.data thread.
+    if (pending_error)
+      std::rethrow_exception (pending_error);
+
+    if (completed_error)
+      std::rethrow_exception (completed_error);
+
+    auto pending_tasks = pending.get_tasks ();
+    std::vector <Task> completed_tasks;
+    if (scan_completed)
+      completed_tasks = completed.get_tasks ();
 
     bool pending_changes = false;
     bool completed_changes = false;
     std::vector <Task> pending_tasks_after;
     std::vector <Task> completed_tasks_after;
+    std::vector <Task> relocated_tasks;
 
     // Reduce unnecessary allocation/copies.
     pending_tasks_after.reserve (pending_tasks.size ());
@@ -1203,14 +2764,11 @@ int TDB2::gc ()
       }
       else
       {
-        completed_tasks_after.push_back (task);
+        relocated_tasks.push_back (task);
         pending_changes = true;
-        completed_changes = true;
       }
     }
 
-    // TODO Join completed.data thread.
-
     // Reduce unnecessary allocation/copies.
     completed_tasks_after.reserve (completed_tasks.size ());
 
@@ -1252,6 +2810,7 @@ int TDB2::gc ()
     // Only recreate the pending.data file if necessary.
     if (pending_changes)
     {
+      pending.journal_changes (pending_tasks_after);
       pending._tasks = pending_tasks_after;
       pending._dirty = true;
       pending._loaded_tasks = true;
@@ -1260,18 +2819,30 @@ int TDB2::gc ()
       for (auto& task : pending._tasks)
         task.id = _id++;
 
+      pending.rebuild_index ();
+
       // Note: deliberately no commit.
     }
 
-    // Only recreate the completed.data file if necessary.
+    // Only recreate the completed.data file if tasks left it.  Tasks that
+    // only arrived are appended, so it need not even be loaded.
     if (completed_changes)
     {
+      completed_tasks_after.insert (completed_tasks_after.end (),
+                                    relocated_tasks.begin (),
+                                    relocated_tasks.end ());
       completed._tasks = completed_tasks_after;
       completed._dirty = true;
       completed._loaded_tasks = true;
+      completed.rebuild_index ();
 
       // Note: deliberately no commit.
     }
+    else
+    {
+      for (auto& task : relocated_tasks)
+        completed.relocate_task (task);
+    }
 
     // TODO Remove dangling dependencies
   }
@@ -1333,6 +2904,29 @@ bool TDB2::get (const std::string& uuid, Task& task)
          completed.get (uuid, task);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Locate tasks by complete UUID, wherever they are, appending those found to
+// tasks, pending tasks first, each in file order.
+void TDB2::get (
+  const std::vector <std::string>& uuids,
+  std::vector <Task>& tasks)
+{
+  unsigned int first = tasks.size ();
+  pending.get (uuids, tasks);
+
+  std::set <std::string> found;
+  for (unsigned int i = first; i < tasks.size (); ++i)
+    found.insert (tasks[i].get ("uuid"));
+
+  std::vector <std::string> remaining;
+  for (auto& uuid : uuids)
+    if (found.find (uuid) == found.end ())
+      remaining.push_back (uuid);
+
+  if (remaining.size ())
+    completed.get (remaining, tasks);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Locate task by UUID, wherever it is.
 bool TDB2::has (const std::string& uuid)
@@ -1405,6 +2999,87 @@ const std::vector <Task> TDB2::children (Task& task)
   return results;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Extracts the attributes of tasks into columns, in one pass over the tasks.
+// The tags of each task are numbered as they are split, and only set as bits
+// once the number of tags, and therefore the bitset width, is known.
+void TDB2::snapshot (const std::vector <Task>& tasks, TDB2Snapshot& snapshot) const
+{
+  snapshot.clear ();
+
+  auto count = tasks.size ();
+  snapshot._status.reserve (count);
+  snapshot._entry.reserve (count);
+  snapshot._end.reserve (count);
+  snapshot._start.reserve (count);
+  snapshot._due.reserve (count);
+  snapshot._project.reserve (count);
+  snapshot._blocked.reserve (count);
+  snapshot._blocking.reserve (count);
+  snapshot._annotations.reserve (count);
+  snapshot._description_length.reserve (count);
+
+  std::unordered_map <std::string, unsigned int> projects;
+  std::unordered_map <std::string, unsigned int> tag_numbers;
+  std::vector <unsigned int> tags;
+  std::vector <size_t> tags_end;
+  tags_end.reserve (count);
+
+  for (auto& task : tasks)
+  {
+    snapshot._status.push_back (task.getStatus ());
+    snapshot._entry.push_back (task.get_date ("entry"));
+    snapshot._end.push_back (task.get_date ("end"));
+    snapshot._start.push_back (task.get_date ("start"));
+    snapshot._due.push_back (task.get_date ("due"));
+    snapshot._blocked.push_back (task.is_blocked);
+    snapshot._blocking.push_back (task.is_blocking);
+    snapshot._annotations.push_back (task.annotation_count);
+    snapshot._description_length.push_back (task.get_ref ("description").length ());
+
+    const std::string& project = task.get_ref ("project");
+    auto p = projects.find (project);
+    if (p == projects.end ())
+    {
+      p = projects.insert (std::make_pair (project, (unsigned int) snapshot._projects.size ())).first;
+      snapshot._projects.push_back (project);
+    }
+
+    snapshot._project.push_back (p->second);
+
+    // Tags split as Task::getTags does.
+    const std::string& list = task.get_ref ("tags");
+    std::string::size_type start = 0;
+    while (start < list.length () || (start && start == list.length ()))
+    {
+      auto comma = list.find (',', start);
+      if (comma == std::string::npos)
+        comma = list.length ();
+
+      std::string tag = list.substr (start, comma - start);
+      auto t = tag_numbers.find (tag);
+      if (t == tag_numbers.end ())
+      {
+        t = tag_numbers.insert (std::make_pair (tag, (unsigned int) snapshot._tag_names.size ())).first;
+        snapshot._tag_names.push_back (tag);
+      }
+
+      tags.push_back (t->second);
+      start = comma + 1;
+    }
+
+    tags_end.push_back (tags.size ());
+  }
+
+  snapshot._tag_words = (snapshot._tag_names.size () + 63) / 64;
+  snapshot._tags.assign (count * snapshot._tag_words, 0);
+
+  size_t next = 0;
+  for (size_t row = 0; row < count; ++row)
+    for (; next < tags_end[row]; ++next)
+      snapshot._tags[row * snapshot._tag_words + tags[next] / 64] |= (uint64_t) 1 << (tags[next] % 64);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string TDB2::uuid (int id)
 {
@@ -28,13 +28,45 @@
 #define INCLUDED_TDB2
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <stdio.h>
+#include <stdint.h>
 #include <ViewText.h>
 #include <FS.h>
 #include <Task.h>
 
+// TF2Summary represents one record of a task file, as described by the
+// file's summary, which is enough to locate the record, and to decide whether
+// it is worth reading.
+class TF2Summary
+{
+public:
+  std::string _uuid;
+  std::string _status;
+  std::string _end;
+  std::string _project;
+  size_t      _offset;
+  size_t      _length;
+};
+
+// TF2Tally counts the tasks of a file that share a project and a status, and
+// were added, and ended, in the same months, which is all that reports counting
+// tasks by period or project need of them.  Months are the local times at which
+// they start, and the end month is zero for tasks with no end.  The age is the
+// total time taken by those tasks that have both an entry and an end date.
+class TF2Tally
+{
+public:
+  std::string _project;
+  std::string _status;
+  time_t      _entry;
+  time_t      _end;
+  int         _count;
+  long long   _age;
+};
+
 // TF2 Class represents a single file in the task database.
 class TF2
 {
@@ -43,35 +75,78 @@ public:
   ~TF2 ();
 
   void target (const std::string&);
+  void summary (const std::string&);
+  void statistics (const std::string&);
+  void journal (const std::string&);
 
   const std::vector <Task>&        get_tasks ();
   const std::vector <std::string>& get_lines ();
 
   bool get (int, Task&);
   bool get (const std::string&, Task&);
+  void get (const std::vector <std::string>&, std::vector <Task>&);
   bool has (const std::string&);
 
+  bool summarized ();
+  void discard_summary ();
+  const std::vector <TF2Summary>& get_summary ();
+  bool read_tasks (const std::vector <TF2Summary>&, std::vector <Task>&);
+
+  bool tallied ();
+  const std::vector <TF2Tally>& get_tallies ();
+
   void add_task (Task&);
+  void relocate_task (const Task&);
   bool modify_task (const Task&);
   void add_line (const std::string&);
   void clear_tasks ();
   void clear_lines ();
+  void journal_changes (const std::vector <Task>&);
   void commit ();
+  void sync ();
+  bool replace ();
+  void finish ();
+  void compact ();
 
-  void load_tasks ();
+  void load_tasks (bool timed = true);
   void load_lines ();
 
   // ID <--> UUID mapping.
   std::string uuid (int);
   int id (const std::string&);
 
+  void get_blocked (const std::string&, std::vector <Task>&);
+  void get_blocking (const Task&, std::vector <Task>&);
+  float inherited_urgency (const std::string&);
+
   void has_ids ();
   void auto_dep_scan ();
   void clear ();
+  void rebuild_index ();
   const std::string dump ();
 
 private:
   void dependency_scan ();
+  void index_dependencies (unsigned int);
+  void unindex_dependencies (unsigned int);
+  void flag_dependencies (unsigned int);
+  void update_dependencies (unsigned int, const std::vector <std::string>&);
+  void index_task (unsigned int);
+  int slot (const std::string&);
+  const TF2Summary* find_summary (const std::string&);
+  bool read_summary ();
+  void write_summary ();
+  void summarize (const Task&, size_t, size_t);
+  bool read_tallies ();
+  void write_tallies ();
+  void clear_tallies ();
+  void tally (const Task&);
+  void journal_task (const Task&);
+  void journal_removal (const std::string&);
+  bool journaled ();
+  void write_journal ();
+  void rewrite ();
+  size_t replay_journal (std::vector <std::pair <const char*, size_t>>&);
 
 public:
   bool _read_only;
@@ -83,13 +158,92 @@ public:
   std::vector <Task> _tasks;
   std::vector <Task> _added_tasks;
   std::vector <Task> _modified_tasks;
+  std::vector <Task> _relocated_tasks;
   std::vector <std::string> _lines;
   std::vector <std::string> _added_lines;
   File _file;
+  File _summary_file;
 
 private:
   std::map <int, std::string> _I2U; // ID -> UUID map
   std::map <std::string, int> _U2I; // UUID -> ID map
+
+  // UUID -> _tasks slot, for exact lookups, and lower-case UUID -> _tasks slot,
+  // ordered for partial UUID lookups.  The latter is only built on demand.
+  std::unordered_map <std::string, unsigned int> _U2S;
+  std::map <std::string, unsigned int>           _P2S;
+  bool                                           _prefix_indexed;
+
+  // UUID -> _tasks slots of the tasks that depend on it, for files that are
+  // scanned for dependencies.
+  std::unordered_map <std::string, std::vector <unsigned int>> _D2S;
+
+  // The summary, and the size and modification time of the file it describes.
+  std::vector <TF2Summary> _summary;
+  size_t                   _summary_size;
+  time_t                   _summary_mtime;
+  bool                     _loaded_summary;
+  bool                     _summary_current;
+  bool                     _summary_dirty;
+
+  // The tallies, which are kept with the summary, and the size and
+  // modification time of the file they describe.
+  File                                           _tally_file;
+  std::vector <TF2Tally>                         _tallies;
+  std::unordered_map <std::string, unsigned int> _tally_slots;
+  size_t                                         _tally_size;
+  time_t                                         _tally_mtime;
+  bool                                           _loaded_tallies;
+  bool                                           _tallies_current;
+  bool                                           _count_tallies;
+
+  // The journal, to which changes are appended instead of rewriting the file,
+  // the records not yet written to it, and the number of records in it, as
+  // last seen.
+  File                      _journal_file;
+  bool                      _journaling;
+  std::vector <std::string> _journal;
+  size_t                    _journal_records;
+
+  // What commit has written, for finish to complete: a rewritten copy of the
+  // file, the file it replaces, and whether the file itself was appended to,
+  // or rewritten.
+  File                      _staged_file;
+  std::string               _staged_target;
+  bool                      _appended;
+  bool                      _rewritten;
+};
+
+// TDB2Snapshot holds, one contiguous column per attribute, those attributes of
+// a set of tasks that commands aggregating over many tasks read, so that they
+// need not look tasks up by name, nor parse their values, for each task.  Row
+// i describes the i-th task given to TDB2::snapshot.  Dates are epoch times,
+// zero when absent.  Projects and tags are numbered in the order first seen,
+// and each row's tags are a bitset of tag numbers, _tag_words wide.
+class TDB2Snapshot
+{
+public:
+  size_t size () const;
+  bool has_tag (size_t, unsigned int) const;
+  unsigned int tag_count (size_t) const;
+  void clear ();
+
+public:
+  std::vector <Task::status> _status;
+  std::vector <time_t>       _entry;
+  std::vector <time_t>       _end;
+  std::vector <time_t>       _start;
+  std::vector <time_t>       _due;
+  std::vector <unsigned int> _project;
+  std::vector <uint64_t>     _tags;
+  std::vector <char>         _blocked;
+  std::vector <char>         _blocking;
+  std::vector <unsigned int> _annotations;
+  std::vector <size_t>       _description_length;
+
+  std::vector <std::string>  _projects;
+  std::vector <std::string>  _tag_names;
+  size_t                     _tag_words;
 };
 
 // TDB2 Class represents all the files in the task database.
@@ -113,9 +267,11 @@ public:
   const std::vector <Task> all_tasks ();
   bool get (int, Task&);
   bool get (const std::string&, Task&);
+  void get (const std::vector <std::string>&, std::vector <Task>&);
   bool has (const std::string&);
   const std::vector <Task> siblings (Task&);
   const std::vector <Task> children (Task&);
+  void snapshot (const std::vector <Task>&, TDB2Snapshot&) const;
 
   // ID <--> UUID mapping.
   std::string uuid (int);
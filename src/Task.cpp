@@ -27,8 +27,10 @@
 #include <cmake.h>
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <string>
+#include <unordered_map>
 #ifdef PRODUCT_TASKWARRIOR
 #include <math.h>
 #include <ctype.h>
@@ -61,18 +63,52 @@
 #define APPROACHING_INFINITY 1000   // Close enough.  This isn't rocket surgery.
 
 extern Context context;
-extern Task& contextTask;
 
 static const float epsilon = 0.000001;
+
+// Day boundaries against which due dates are classified.  Named dates are
+// costly to resolve, so they are resolved once per day, per thread.
+struct DateAnchors
+{
+  time_t _today;
+  time_t _tomorrow;
+  time_t _yesterday;
+  time_t _dayAfterTomorrow;
+  time_t _socw;
+  time_t _eocw;
+  time_t _socm;
+  time_t _eocm;
+  int    _year;
+};
+
+static const DateAnchors& dateAnchors (time_t now)
+{
+  static thread_local DateAnchors anchors = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+  if (now < anchors._today ||
+      now >= anchors._tomorrow)
+  {
+    anchors._today            = Date ("today").toEpoch ();
+    anchors._tomorrow         = Date ("tomorrow").toEpoch ();
+    anchors._yesterday        = Date ("yesterday").toEpoch ();
+    anchors._dayAfterTomorrow = (Date ("tomorrow") + 90001).startOfDay ().toEpoch ();
+    anchors._socw             = Date ("socw").toEpoch ();
+    anchors._eocw             = Date ("eocw").toEpoch ();
+    anchors._socm             = Date ("socm").toEpoch ();
+    anchors._eocm             = Date ("eocm").toEpoch ();
+    anchors._year             = Date (now).year ();
+  }
+
+  return anchors;
+}
 #endif
 
 std::string Task::defaultProject  = "";
 std::string Task::defaultDue      = "";
+std::map <std::string, std::string> Task::defaultUDAs;
 bool Task::searchCaseSensitive    = true;
 bool Task::regex                  = false;
 std::map <std::string, std::string> Task::attributes;
 
-std::map <std::string, float> Task::coefficients;
 float Task::urgencyProjectCoefficient     = 0.0;
 float Task::urgencyActiveCoefficient      = 0.0;
 float Task::urgencyScheduledCoefficient   = 0.0;
@@ -84,11 +120,116 @@ float Task::urgencyDueCoefficient         = 0.0;
 float Task::urgencyBlockingCoefficient    = 0.0;
 float Task::urgencyAgeCoefficient         = 0.0;
 float Task::urgencyAgeMax                 = 0.0;
+bool Task::urgencyInherit                 = false;
+
+std::vector <Task::UrgencyRule> Task::urgencyUDARules;
+std::vector <Task::UrgencyRule> Task::urgencyKeywordRules;
+std::vector <Task::UrgencyRule> Task::urgencyProjectRules;
+std::vector <Task::UrgencyRule> Task::urgencyTagRules;
 
 std::map <std::string, std::vector <std::string>> Task::customOrder;
 
 static const std::string dummy ("");
 
+// Interned attribute names.  A slot indexes these, and the rank of a slot is
+// the position of its name in name order, which is the order in which a task
+// keeps its attributes.  Only Task::internAttributes modifies these, before
+// any tasks are loaded, so that tasks may be parsed on several threads.
+static std::vector <std::string>                        slotNames;
+static std::vector <unsigned short>                     slotRanks;
+static std::vector <char>                               slotTypes;
+static std::unordered_map <std::string, unsigned short> slotIndex;
+
+////////////////////////////////////////////////////////////////////////////////
+Task::const_iterator::const_iterator (
+  const Task* task,
+  unsigned int attribute,
+  std::map <std::string, std::string>::const_iterator extra)
+: _task (task)
+, _attribute (attribute)
+, _extra (extra)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::pair <const std::string&, const std::string&> Task::const_iterator::operator* () const
+{
+  if (interned ())
+  {
+    const Attribute& attribute = _task->_attributes[_attribute];
+    return std::pair <const std::string&, const std::string&> (slotNames[attribute._slot], attribute._value);
+  }
+
+  return std::pair <const std::string&, const std::string&> (_extra->first, _extra->second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Task::const_iterator& Task::const_iterator::operator++ ()
+{
+  if (interned ())
+    ++_attribute;
+  else
+    ++_extra;
+
+  return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Task::const_iterator::operator== (const const_iterator& other) const
+{
+  return _attribute == other._attribute &&
+         _extra     == other._extra;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool Task::const_iterator::operator!= (const const_iterator& other) const
+{
+  return ! (*this == other);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The interned and other attributes are merged, in name order.
+bool Task::const_iterator::interned () const
+{
+  if (_attribute >= _task->_attributes.size ())
+    return false;
+
+  if (_extra == _task->_extra.end ())
+    return true;
+
+  return slotNames[_task->_attributes[_attribute]._slot] < _extra->first;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Interns the names of all known attributes, including UDAs, assigning each a
+// slot, so that tasks store them compactly.  Names are only ever added, so any
+// existing task remains valid.
+void Task::internAttributes ()
+{
+  for (auto& attribute : Task::attributes)
+  {
+    if (slotIndex.find (attribute.first) == slotIndex.end ())
+    {
+      slotIndex[attribute.first] = slotNames.size ();
+      slotNames.push_back (attribute.first);
+      slotTypes.push_back (attribute.second == "date"    ? 'd' :
+                           attribute.second == "numeric" ? 'n' :
+                                                           's');
+    }
+  }
+
+  // Rank the slots by name.
+  std::vector <std::pair <std::string, unsigned short>> ordered;
+  for (auto& name : slotIndex)
+    ordered.push_back (name);
+
+  std::sort (ordered.begin (), ordered.end ());
+
+  slotRanks.resize (slotNames.size ());
+  for (unsigned int rank = 0; rank < ordered.size (); ++rank)
+    slotRanks[ordered[rank].second] = rank;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Task::Task ()
 : id (0)
@@ -111,7 +252,8 @@ Task& Task::operator= (const Task& other)
 {
   if (this != &other)
   {
-    std::map <std::string, std::string>::operator= (other);
+    _attributes      = other._attributes;
+    _extra           = other._extra;
     id               = other.id;
     urgency_value    = other.urgency_value;
     recalc_urgency   = other.recalc_urgency;
@@ -140,7 +282,7 @@ bool Task::operator== (const Task& other)
   if (size () != other.size ())
     return false;
 
-  for (auto& i : *this)
+  for (auto i : *this)
     if (i.first != "uuid" &&
         i.second != other.get (i.first))
       return false;
@@ -148,6 +290,12 @@ bool Task::operator== (const Task& other)
   return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+bool Task::operator!= (const Task& other)
+{
+  return ! (*this == other);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Task::Task (const std::string& input)
 {
@@ -216,19 +364,15 @@ void Task::setAsNow (const std::string& att)
 ////////////////////////////////////////////////////////////////////////////////
 bool Task::has (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return true;
-
-  return false;
+  return lookup (name) != NULL;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 std::vector <std::string> Task::all ()
 {
   std::vector <std::string> all;
-  for (auto i = this->begin (); i != this->end (); ++i)
-    all.push_back (i->first);
+  for (auto i : *this)
+    all.push_back (i.first);
 
   return all;
 }
@@ -236,9 +380,9 @@ std::vector <std::string> Task::all ()
 ////////////////////////////////////////////////////////////////////////////////
 const std::string Task::get (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return i->second;
+  auto value = lookup (name);
+  if (value)
+    return *value;
 
   return "";
 }
@@ -246,9 +390,9 @@ const std::string Task::get (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 const std::string& Task::get_ref (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return i->second;
+  auto value = lookup (name);
+  if (value)
+    return *value;
 
   return dummy;
 }
@@ -256,9 +400,9 @@ const std::string& Task::get_ref (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 int Task::get_int (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return strtol (i->second.c_str (), NULL, 10);
+  auto value = lookup (name);
+  if (value)
+    return strtol (value->c_str (), NULL, 10);
 
   return 0;
 }
@@ -266,9 +410,9 @@ int Task::get_int (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 unsigned long Task::get_ulong (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return strtoul (i->second.c_str (), NULL, 10);
+  auto value = lookup (name);
+  if (value)
+    return strtoul (value->c_str (), NULL, 10);
 
   return 0;
 }
@@ -276,9 +420,13 @@ unsigned long Task::get_ulong (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 float Task::get_float (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return strtof (i->second.c_str (), NULL);
+  auto attribute = lookup (slot (name));
+  if (attribute && slotTypes[attribute->_slot] == 'n')
+    return attribute->_number;
+
+  auto value = lookup (name);
+  if (value)
+    return strtof (value->c_str (), NULL);
 
   return 0.0;
 }
@@ -286,9 +434,13 @@ float Task::get_float (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 time_t Task::get_date (const std::string& name) const
 {
-  auto i = this->find (name);
-  if (i != this->end ())
-    return (time_t) strtoul (i->second.c_str (), NULL, 10);
+  auto attribute = lookup (slot (name));
+  if (attribute && slotTypes[attribute->_slot] == 'd')
+    return attribute->_date;
+
+  auto value = lookup (name);
+  if (value)
+    return (time_t) strtoul (value->c_str (), NULL, 10);
 
   return 0;
 }
@@ -296,7 +448,7 @@ time_t Task::get_date (const std::string& name) const
 ////////////////////////////////////////////////////////////////////////////////
 void Task::set (const std::string& name, const std::string& value)
 {
-  (*this)[name] = json::decode (value);
+  store (name, json::decode (value));
 
   recalc_urgency = true;
 }
@@ -304,7 +456,7 @@ void Task::set (const std::string& name, const std::string& value)
 ////////////////////////////////////////////////////////////////////////////////
 void Task::set (const std::string& name, int value)
 {
-  (*this)[name] = format (value);
+  store (name, format (value));
 
   recalc_urgency = true;
 }
@@ -312,14 +464,129 @@ void Task::set (const std::string& name, int value)
 ////////////////////////////////////////////////////////////////////////////////
 void Task::remove (const std::string& name)
 {
-  auto it = this->find (name);
-  if (it != this->end ())
+  if (has (name))
   {
-    this->erase (it);
+    erase (name);
     recalc_urgency = true;
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+Task::const_iterator Task::begin () const
+{
+  return const_iterator (this, 0, _extra.begin ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+Task::const_iterator Task::end () const
+{
+  return const_iterator (this, _attributes.size (), _extra.end ());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t Task::size () const
+{
+  return _attributes.size () + _extra.size ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Task::clear ()
+{
+  _attributes.clear ();
+  _extra.clear ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Returns the slot of an interned name, or -1.
+int Task::slot (const std::string& name)
+{
+  auto i = slotIndex.find (name);
+  if (i != slotIndex.end ())
+    return i->second;
+
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const std::string* Task::lookup (const std::string& name) const
+{
+  auto attribute = lookup (slot (name));
+  if (attribute)
+    return &attribute->_value;
+
+  // A task may hold an interned name here, if it was set before the name was
+  // interned.
+  if (_extra.size ())
+  {
+    auto i = _extra.find (name);
+    if (i != _extra.end ())
+      return &i->second;
+  }
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const Task::Attribute* Task::lookup (int slot) const
+{
+  if (slot != -1)
+    for (auto& attribute : _attributes)
+      if (attribute._slot == slot)
+        return &attribute;
+
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Task::store (const std::string& name, std::string value)
+{
+  int s = slot (name);
+  if (s == -1)
+  {
+    _extra[name] = std::move (value);
+    return;
+  }
+
+  if (_extra.size ())
+    _extra.erase (name);
+
+  // Attributes are kept in name order, which is rank order.
+  auto i = _attributes.begin ();
+  while (i != _attributes.end () && slotRanks[i->_slot] < slotRanks[s])
+    ++i;
+
+  if (i == _attributes.end () || i->_slot != s)
+  {
+    i = _attributes.insert (i, Attribute ());
+    i->_slot = s;
+  }
+
+  i->_value = std::move (value);
+  if (slotTypes[s] == 'd')
+    i->_date = (time_t) strtoul (i->_value.c_str (), NULL, 10);
+  else if (slotTypes[s] == 'n')
+    i->_number = strtof (i->_value.c_str (), NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Task::erase (const std::string& name)
+{
+  int s = slot (name);
+  if (s != -1)
+  {
+    for (auto i = _attributes.begin (); i != _attributes.end (); ++i)
+    {
+      if (i->_slot == s)
+      {
+        _attributes.erase (i);
+        break;
+      }
+    }
+  }
+
+  _extra.erase (name);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 Task::status Task::getStatus () const
 {
@@ -338,17 +605,16 @@ void Task::setStatus (Task::status status)
 // Determines status of a date attribute.
 Task::dateState Task::getDateState (const std::string& name) const
 {
-  std::string value = get (name);
-  if (value.length ())
+  if (get_ref (name) != "")
   {
-    Date reference (value);
-    Date now;
-    Date today ("today");
+    time_t reference = get_date (name);
+    time_t now = time (NULL);
+    const DateAnchors& anchors = dateAnchors (now);
 
-    if (reference < today)
+    if (reference < anchors._today)
       return dateBeforeToday;
 
-    if (reference.sameDay (now))
+    if (reference < anchors._tomorrow)
     {
       if (reference < now)
         return dateEarlierToday;
@@ -360,8 +626,7 @@ Task::dateState Task::getDateState (const std::string& name) const
     if (imminentperiod == 0)
       return dateAfterToday;
 
-    Date imminentDay = today + imminentperiod * 86400;
-    if (reference < imminentDay)
+    if (reference < anchors._today + imminentperiod * 86400)
       return dateAfterToday;
   }
 
@@ -377,7 +642,7 @@ bool Task::is_ready () const
   return getStatus () == Task::pending &&
          ! is_blocked                  &&
          (! has ("scheduled")          ||
-          Date ("now").operator> (get_date ("scheduled")));
+          get_date ("scheduled") < time (NULL));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -411,7 +676,10 @@ bool Task::is_dueyesterday () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      if (Date ("yesterday").sameDay (get_date ("due")))
+      const DateAnchors& anchors = dateAnchors (time (NULL));
+      time_t due = get_date ("due");
+      if (due >= anchors._yesterday &&
+          due <  anchors._today)
         return true;
     }
   }
@@ -449,7 +717,10 @@ bool Task::is_duetomorrow () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      if (Date ("tomorrow").sameDay (get_date ("due")))
+      const DateAnchors& anchors = dateAnchors (time (NULL));
+      time_t due = get_date ("due");
+      if (due >= anchors._tomorrow &&
+          due <  anchors._dayAfterTomorrow)
         return true;
     }
   }
@@ -467,9 +738,10 @@ bool Task::is_dueweek () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date due (get_date ("due"));
-      if (due >= Date ("socw") &&
-          due <= Date ("eocw"))
+      const DateAnchors& anchors = dateAnchors (time (NULL));
+      time_t due = get_date ("due");
+      if (due >= anchors._socw &&
+          due <= anchors._eocw)
         return true;
     }
   }
@@ -487,9 +759,10 @@ bool Task::is_duemonth () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date due (get_date ("due"));
-      if (due >= Date ("socm") &&
-          due <= Date ("eocm"))
+      const DateAnchors& anchors = dateAnchors (time (NULL));
+      time_t due = get_date ("due");
+      if (due >= anchors._socm &&
+          due <= anchors._eocm)
         return true;
     }
   }
@@ -507,9 +780,8 @@ bool Task::is_dueyear () const
     if (status != Task::completed &&
         status != Task::deleted)
     {
-      Date now;
       Date due (get_date ("due"));
-      if (now.year () == due.year ())
+      if (due.year () == dateAnchors (time (NULL))._year)
         return true;
     }
   }
@@ -532,7 +804,7 @@ bool Task::is_udaPresent () const
 ////////////////////////////////////////////////////////////////////////////////
 bool Task::is_orphanPresent () const
 {
-  for (auto& att : *this)
+  for (auto att : *this)
     if (att.first.substr (0, 11) != "annotation_")
       if (context.columns.find (att.first) == context.columns.end ())
         return true;
@@ -589,52 +861,90 @@ void Task::parse (const std::string& input)
     clear ();
 
     if (copy[0] == '[')
+      parseFF4 (copy.data (), copy.length ());
+    else if (copy[0] == '{')
+      parseJSON (copy);
+    else
+      throw std::string (STRING_RECORD_NOT_FF4);
+  }
+
+  catch (const std::string&)
+  {
+    parseLegacy (copy);
+  }
+
+  recalc_urgency = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Parses a file format 4 record only, with no fallback to other formats, and
+// no side effects beyond this task, which means it may be called concurrently
+// on different tasks.  Throws on a malformed record.
+//
+//   [name:"value" ...]
+//
+// The record is scanned in place, so that TF2 can parse directly from a mapped
+// file.  A value keeps any backslash escapes until json::decode.
+void Task::parseFF4 (const char* input, size_t length)
+{
+  // A trailing newline is ignored.
+  if (length && input[length - 1] == '\n')
+    --length;
+
+  // The record must be bracketed, with the only ']' at the end.
+  if (length < 2                 ||
+      input[0] != '['            ||
+      input[length - 1] != ']'   ||
+      memchr (input, ']', length) != input + length - 1)
+    return;
+
+  const char* cursor = input + 1;
+  const char* end    = input + length - 1;
+  if (cursor == end)
+    throw std::string (STRING_RECORD_EMPTY);
+
+  std::string name;
+  std::string value;
+  while (cursor < end)
+  {
+    // <name>
+    const char* colon = (const char*) memchr (cursor, ':', end - cursor);
+    if (! colon)
+      break;
+
+    name.assign (cursor, colon - cursor);
+    cursor = colon + 1;
+
+    // :"<value>"
+    if (cursor < end && *cursor == '"')
     {
-      Nibbler n (copy);
-      std::string line;
-      if (n.skip     ('[')       &&
-          n.getUntil (']', line) &&
-          n.skip     (']')       &&
-          n.depleted ())
+      const char* start = ++cursor;
+      bool escaped = false;
+      while (cursor < end && (escaped || *cursor != '"'))
       {
-        if (line.length () == 0)
-          throw std::string (STRING_RECORD_EMPTY);
+        escaped = ! escaped && *cursor == '\\';
+        ++cursor;
+      }
 
-        Nibbler nl (line);
-        std::string name;
-        std::string value;
-        while (!nl.depleted ())
-        {
-          if (nl.getUntil (':', name) &&
-              nl.skip (':')           &&
-              nl.getQuoted ('"', value))
-          {
-            legacyAttributeMap (name);
+      if (cursor < end)
+      {
+        value.assign (start, cursor - start);
+        ++cursor;
 
-            if (name.substr (0, 11) == "annotation_")
-              ++annotation_count;
+        legacyAttributeMap (name);
 
-            (*this)[name] = decode (json::decode (value));
-          }
+        if (name.compare (0, 11, "annotation_") == 0)
+          ++annotation_count;
 
-          nl.skip (' ');
-        }
+        if (value.find ('\\') != std::string::npos)
+          value = json::decode (value);
 
-        std::string remainder;
-        nl.getUntilEOS (remainder);
-        if (remainder.length ())
-          throw std::string (STRING_RECORD_JUNK_AT_EOL);
+        store (name, decode (value));
       }
     }
-    else if (copy[0] == '{')
-      parseJSON (copy);
-    else
-      throw std::string (STRING_RECORD_NOT_FF4);
-  }
 
-  catch (const std::string&)
-  {
-    parseLegacy (copy);
+    if (cursor < end && *cursor == ' ')
+      ++cursor;
   }
 
   recalc_urgency = true;
@@ -653,6 +963,16 @@ void Task::parseJSON (const std::string& line)
   delete root;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The text of a value, which for a string is as written, without the quotes.
+static std::string jsonText (json::value* value)
+{
+  if (value->type () == json::j_string)
+    return ((json::string*) value)->_data;
+
+  return unquoteText (value->dump ());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void Task::parseJSON (const json::object* root_obj)
 {
@@ -660,7 +980,8 @@ void Task::parseJSON (const json::object* root_obj)
   for (auto& i : root_obj->_data)
   {
     // If the attribute is a recognized column.
-    std::string type = Task::attributes[i.first];
+    auto column = Task::attributes.find (i.first);
+    std::string type = column != Task::attributes.end () ? column->second : "";
     if (type != "")
     {
       // Any specified id is ignored.
@@ -674,14 +995,14 @@ void Task::parseJSON (const json::object* root_obj)
       // TW-1274 Standardization.
       else if (i.first == "modification")
       {
-        Date d (unquoteText (i.second->dump ()));
+        Date d (jsonText (i.second));
         set ("modified", d.toEpochString ());
       }
 
       // Dates are converted from ISO to epoch.
       else if (type == "date")
       {
-        std::string text = unquoteText (i.second->dump ());
+        std::string text = jsonText (i.second);
         Date d (text);
         set (i.first, text == "" ? "" : d.toEpochString ());
       }
@@ -718,11 +1039,11 @@ void Task::parseJSON (const json::object* root_obj)
 
       // Strings are decoded.
       else if (type == "string")
-        set (i.first, json::decode (unquoteText (i.second->dump ())));
+        set (i.first, json::decode (jsonText (i.second)));
 
       // Other types are simply added.
       else
-        set (i.first, unquoteText (i.second->dump ()));
+        set (i.first, jsonText (i.second));
     }
 
     // UDA orphans and annotations do not have columns.
@@ -766,7 +1087,7 @@ void Task::parseJSON (const json::object* root_obj)
                 << "' --> preserved\n";
         context.debug (message.str ());
 #endif
-        set (i.first, json::decode (unquoteText (i.second->dump ())));
+        set (i.first, json::decode (jsonText (i.second)));
       }
     }
   }
@@ -832,23 +1153,54 @@ std::string Task::composeF4 () const
   return ff4;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Appends a date, stored as an epoch, in ISO 8601 form.  Anything else is
+// parsed as Date would.
+static void composeISO (std::string& out, const std::string& value)
+{
+  time_t t;
+  if ((value.length () == 9 || value.length () == 10) &&
+      Lexer::isAllDigits (value))
+    t = (time_t) atoi (value.c_str ());
+  else
+    t = Date (value).toEpoch ();
+
+  struct tm parts;
+  gmtime_r (&t, &parts);
+
+  char iso[64];
+  snprintf (iso, sizeof (iso), "%04d%02d%02dT%02d%02d%02dZ",
+            parts.tm_year + 1900, parts.tm_mon + 1, parts.tm_mday,
+            parts.tm_hour, parts.tm_min, parts.tm_sec);
+  out += iso;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 std::string Task::composeJSON (bool decorate /*= false*/) const
 {
-  std::stringstream out;
-  out << "{";
+  std::string out;
+  composeJSON (out, decorate);
+  return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Appends the task to out, which callers composing many tasks reuse, rather
+// than allocating for each.
+void Task::composeJSON (std::string& out, bool decorate /*= false*/) const
+{
+  out += "{";
 
   // ID inclusion is optional, but not a good idea, because it remains correct
   // only until the next gc.
   if (decorate)
-    out << "\"id\":" << id << ",";
+    out += "\"id\":" + std::to_string (id) + ",";
 
   // First the non-annotations.
   int attributes_written = 0;
-  for (auto& i : *this)
+  for (auto i : *this)
   {
     // Annotations are not written out here.
-    if (i.first.substr (0, 11) == "annotation_")
+    if (! i.first.compare (0, 11, "annotation_"))
       continue;
 
     // If value is an empty string, do not ever output it
@@ -856,22 +1208,18 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
         continue;
 
     if (attributes_written)
-      out << ",";
+      out += ",";
 
-    std::string type = Task::attributes[i.first];
-    if (type == "")
-      type = "string";
+    auto type = Task::attributes.find (i.first);
 
     // Date fields are written as ISO 8601.
-    if (type == "date")
+    if (type != Task::attributes.end () && type->second == "date")
     {
-      Date d (i.second);
-      out << "\""
-          << (i.first == "modification" ? "modified" : i.first)
-          << "\":\""
-          // Date was deleted, do not export parsed empty string
-          << (i.second == "" ? "" : d.toISO ())
-          << "\"";
+      out += "\"";
+      out += (i.first == "modification" ? "modified" : i.first);
+      out += "\":\"";
+      composeISO (out, i.second);
+      out += "\"";
 
       ++attributes_written;
     }
@@ -882,12 +1230,12 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
       // TODO Emit ISO8601d
     }
 */
-    else if (type == "numeric")
+    else if (type != Task::attributes.end () && type->second == "numeric")
     {
-      out << "\""
-          << i.first
-          << "\":"
-          << i.second;
+      out += "\"";
+      out += i.first;
+      out += "\":";
+      out += i.second;
 
       ++attributes_written;
     }
@@ -895,20 +1243,14 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
     // Tags are converted to an array.
     else if (i.first == "tags")
     {
-      std::vector <std::string> tags;
-      split (tags, i.second, ',');
-
-      out << "\"tags\":[";
-
-      for (auto i = tags.begin (); i != tags.end (); ++i)
-      {
-        if (i != tags.begin ())
-          out << ",";
-
-        out << "\"" << *i << "\"";
-      }
+      out += "\"tags\":[\"";
+      for (auto c : i.second)
+        if (c == ',')
+          out += "\",\"";
+        else
+          out += c;
 
-      out << "]";
+      out += "\"]";
       ++attributes_written;
     }
 
@@ -916,31 +1258,25 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
     else if (i.first == "depends" &&
              context.config.getBoolean ("json.depends.array"))
     {
-      std::vector <std::string> deps;
-      split (deps, i.second, ',');
-
-      out << "\"depends\":[";
-
-      for (auto i = deps.begin (); i != deps.end (); ++i)
-      {
-        if (i != deps.begin ())
-          out << ",";
-
-        out << "\"" << *i << "\"";
-      }
+      out += "\"depends\":[\"";
+      for (auto c : i.second)
+        if (c == ',')
+          out += "\",\"";
+        else
+          out += c;
 
-      out << "]";
+      out += "\"]";
       ++attributes_written;
     }
 
     // Everything else is a quoted value.
     else
     {
-      out << "\""
-          << i.first
-          << "\":\""
-          << json::encode (i.second)
-          << "\"";
+      out += "\"";
+      out += i.first;
+      out += "\":\"";
+      out += json::encode (i.second);
+      out += "\"";
 
       ++attributes_written;
     }
@@ -949,41 +1285,42 @@ std::string Task::composeJSON (bool decorate /*= false*/) const
   // Now the annotations, if any.
   if (annotation_count)
   {
-    out << ","
-        << "\"annotations\":[";
+    out += ",\"annotations\":[";
 
     int annotations_written = 0;
-    for (auto& i : *this)
+    for (auto i : *this)
     {
-      if (i.first.substr (0, 11) == "annotation_")
+      if (! i.first.compare (0, 11, "annotation_"))
       {
         if (annotations_written)
-          out << ",";
+          out += ",";
 
-        Date d (i.first.substr (11));
-        out << "{\"entry\":\""
-            << d.toISO ()
-            << "\",\"description\":\""
-            << json::encode (i.second)
-            << "\"}";
+        out += "{\"entry\":\"";
+        composeISO (out, i.first.substr (11));
+        out += "\",\"description\":\"";
+        out += json::encode (i.second);
+        out += "\"}";
 
         ++annotations_written;
       }
     }
 
-    out << "]";
+    out += "]";
   }
 
 #ifdef PRODUCT_TASKWARRIOR
   // Include urgency.
   if (decorate)
-    out << ","
-        << "\"urgency\":"
-        << urgency_c ();
+  {
+    // As a stream would write it.
+    char urgency[32];
+    snprintf (urgency, sizeof (urgency), "%g", (double) urgency_c ());
+    out += ",\"urgency\":";
+    out += urgency;
+  }
 #endif
 
-  out << "}";
-  return out.str ();
+  out += "}";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1010,7 +1347,7 @@ void Task::addAnnotation (const std::string& description)
   }
   while (has (key));
 
-  (*this)[key] = json::decode (description);
+  store (key, json::decode (description));
   ++annotation_count;
   recalc_urgency = true;
 }
@@ -1019,16 +1356,15 @@ void Task::addAnnotation (const std::string& description)
 void Task::removeAnnotations ()
 {
   // Erase old annotations.
-  auto i = this->begin ();
-  while (i != this->end ())
+  std::vector <std::string> annotations;
+  for (auto i : *this)
+    if (i.first.substr (0, 11) == "annotation_")
+      annotations.push_back (i.first);
+
+  for (auto& annotation : annotations)
   {
-    if (i->first.substr (0, 11) == "annotation_")
-    {
-      --annotation_count;
-      this->erase (i++);
-    }
-    else
-      i++;
+    --annotation_count;
+    erase (annotation);
   }
 
   recalc_urgency = true;
@@ -1039,7 +1375,7 @@ void Task::getAnnotations (std::map <std::string, std::string>& annotations) con
 {
   annotations.clear ();
 
-  for (auto& ann : *this)
+  for (auto ann : *this)
     if (ann.first.substr (0, 11) == "annotation_")
       annotations.insert (ann);
 }
@@ -1051,7 +1387,7 @@ void Task::setAnnotations (const std::map <std::string, std::string>& annotation
   removeAnnotations ();
 
   for (auto& anno : annotations)
-    this->insert (anno);
+    store (anno.first, anno.second);
 
   annotation_count = annotations.size ();
   recalc_urgency = true;
@@ -1282,7 +1618,7 @@ void Task::removeTag (const std::string& tag)
 // A UDA Orphan is an attribute that is not represented in context.columns.
 void Task::getUDAOrphans (std::vector <std::string>& names) const
 {
-  for (auto& it : *this)
+  for (auto it : *this)
     if (it.first.substr (0, 11) != "annotation_")
       if (context.columns.find (it.first) == context.columns.end ())
         names.push_back (it.first);
@@ -1309,8 +1645,8 @@ void Task::substitute (
   // Regex support is optional.
   if (Task::regex)
   {
-    // Create the regex.
-    RX rx (from, Task::searchCaseSensitive);
+    // Get the regex, compiled once per pattern.
+    RX& rx = RX::cached (from, Task::searchCaseSensitive);
     std::vector <int> start;
     std::vector <int> end;
 
@@ -1426,12 +1762,16 @@ void Task::validate (bool applyDefault /* = true */)
   std::string uid = get ("uuid");
   if (has ("uuid") && uid != "")
   {
-    Lexer lex (uid);
-    Lexer::Type type;
-    if (! lex.token (uid, type) ||
-        uid.length () != 36     ||
-        type != Lexer::Type::uuid)
-      throw format (STRING_CMD_IMPORT_UUID_BAD, uid);
+    // Only a value that is not exactly one UUID needs the full Lexer.
+    if (! Lexer::isFullUUID (uid))
+    {
+      Lexer lex (uid);
+      Lexer::Type type;
+      if (! lex.token (uid, type) ||
+          uid.length () != 36     ||
+          type != Lexer::Type::uuid)
+        throw format (STRING_CMD_IMPORT_UUID_BAD, uid);
+    }
   }
   else
     set ("uuid", uuid ());
@@ -1496,32 +1836,9 @@ void Task::validate (bool applyDefault /* = true */)
 
     // If a UDA has a default value in the configuration,
     // override with uda.(uda).default, if not specified.
-    // Gather a list of all UDAs with a .default value
-    std::vector <std::string> udas;
-    for (auto& var : context.config)
-    {
-      if (var.first.substr (0, 4) == "uda." &&
-          var.first.find (".default") != std::string::npos)
-      {
-        auto period = var.first.find ('.', 4);
-        if (period != std::string::npos)
-          udas.push_back (var.first.substr (4, period - 4));
-      }
-    }
-
-    if (udas.size ())
-    {
-      // For each of those, setup the default value on the task now,
-      // of course only if we don't have one on the command line already
-      for (auto& uda : udas)
-      {
-        std::string defVal= context.config.get ("uda." + uda + ".default");
-
-        // If the default is empty, or we already have a value, skip it
-        if (defVal != "" && get (uda) == "")
-          set (uda, defVal);
-      }
-    }
+    for (auto& uda : Task::defaultUDAs)
+      if (get (uda.first) == "")
+        set (uda.first, uda.second);
   }
 #endif
 
@@ -1728,71 +2045,51 @@ float Task::urgency_c () const
   value += fabsf (Task::urgencyBlockingCoefficient)    > epsilon ? (urgency_blocking ()    * Task::urgencyBlockingCoefficient)    : 0.0;
   value += fabsf (Task::urgencyAgeCoefficient)         > epsilon ? (urgency_age ()         * Task::urgencyAgeCoefficient)         : 0.0;
 
-  // Tag- and project-specific coefficients.
-  for (auto& var : Task::coefficients)
+  // UDA-, keyword-, project- and tag-specific coefficients, in the order of
+  // their variable names.
+  for (auto& rule : Task::urgencyUDARules)
   {
-    if (fabs (var.second) > epsilon)
+    // urgency.uda.<name>.<value>.coefficient
+    if (rule._valued)
     {
-      if (var.first.substr (0, 13) == "urgency.user.")
-      {
-        // urgency.user.project.<project>.coefficient
-        auto end = std::string::npos;
-        if (var.first.substr (13, 8) == "project." &&
-            (end = var.first.find (".coefficient")) != std::string::npos)
-        {
-          std::string project = var.first.substr (21, end - 21);
-
-          if (get ("project").find (project) == 0)
-            value += var.second;
-        }
+      if (get_ref (rule._name) == rule._value)
+        value += rule._coefficient;
+    }
 
-        // urgency.user.tag.<tag>.coefficient
-        if (var.first.substr (13, 4) == "tag." &&
-            (end = var.first.find (".coefficient")) != std::string::npos)
-        {
-          std::string tag = var.first.substr (17, end - 17);
+    // urgency.uda.<name>.coefficient
+    else if (has (rule._name))
+      value += rule._coefficient;
+  }
 
-          if (hasTag (tag))
-            value += var.second;
-        }
+  if (Task::urgencyKeywordRules.size ())
+  {
+    const std::string& description = get_ref ("description");
+    for (auto& rule : Task::urgencyKeywordRules)
+      if (description.find (rule._name) != std::string::npos)
+        value += rule._coefficient;
+  }
 
-        // urgency.user.keyword.<keyword>.coefficient
-        if (var.first.substr (13, 8) == "keyword." &&
-            (end = var.first.find (".coefficient")) != std::string::npos)
-        {
-          std::string keyword = var.first.substr (21, end - 21);
+  if (Task::urgencyProjectRules.size ())
+  {
+    const std::string& project = get_ref ("project");
+    for (auto& rule : Task::urgencyProjectRules)
+      if (project.find (rule._name) == 0)
+        value += rule._coefficient;
+  }
 
-          if (get ("description").find (keyword) != std::string::npos)
-            value += var.second;
-        }
-      }
-      else if (var.first.substr (0, 12) == "urgency.uda.")
-      {
-        // urgency.uda.<name>.coefficient
-        // urgency.uda.<name>.<value>.coefficient
-        auto end = var.first.find (".coefficient");
-        if (end != std::string::npos)
-        {
-          const std::string uda = var.first.substr (12, end - 12);
-          auto dot = uda.find (".");
-          if (dot == std::string::npos)
-          {
-            // urgency.uda.<name>.coefficient
-            if (has (uda))
-              value += var.second;
-          }
-          else
-          {
-            // urgency.uda.<name>.<value>.coefficient
-            if (get (uda.substr(0, dot)) == uda.substr(dot+1))
-              value += var.second;
-          }
-        }
-      }
-    }
+  if (Task::urgencyTagRules.size ())
+  {
+    // Split the tags once, leaving only synthetic tags to hasTag.
+    std::vector <std::string> tags;
+    split (tags, get_ref ("tags"), ',');
+
+    for (auto& rule : Task::urgencyTagRules)
+      if (isupper (rule._name[0]) ? hasTag (rule._name)
+                                  : std::find (tags.begin (), tags.end (), rule._name) != tags.end ())
+        value += rule._coefficient;
   }
 
-  if (is_blocking && context.config.getBoolean ("urgency.inherit"))
+  if (is_blocking && Task::urgencyInherit)
   {
     float prev = value;
     value = std::max (value, urgency_inherit ());
@@ -1812,10 +2109,12 @@ float Task::urgency ()
 {
   if (recalc_urgency)
   {
-    urgency_value = urgency_c ();
+    // Settled first, so that inheriting urgency around a dependency cycle, which
+    // should not exist, still terminates.
+    recalc_urgency = false;
 
     // Return the sum of all terms.
-    recalc_urgency = false;
+    urgency_value = urgency_c ();
   }
 
   return urgency_value;
@@ -1824,19 +2123,9 @@ float Task::urgency ()
 ////////////////////////////////////////////////////////////////////////////////
 float Task::urgency_inherit () const
 {
-  // Calling dependencyGetBlocked is rather expensive.
-  // It is called recursively for each dependency in the chain here.
-  std::vector <Task> blocked;
-  dependencyGetBlocked (*this, blocked);
-
-  float v = FLT_MIN;
-  for (auto& task : blocked)
-  {
-    // Find highest urgency in all blocked tasks.
-    v = std::max (v, task.urgency ());
-  }
-
-  return v;
+  // The highest urgency of all blocked tasks, which pending.data computes once
+  // for each task, however many tasks inherit it.
+  return context.tdb2.pending.inherited_urgency (get ("uuid"));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2011,10 +2300,9 @@ void Task::modify (modType type, bool text_required /* = false */)
             try
             {
               Eval e;
-              e.addSource (domSource);
+              e.addSource (context.dom);
               e.addSource (namedDates);
-              contextTask = *this;
-              e.evaluateInfixExpression (value, evaluatedValue);
+              e.evaluateInfixExpression (value, *this, evaluatedValue);
             }
 
             // Ah, fuck it.
@@ -2073,12 +2361,11 @@ void Task::modify (modType type, bool text_required /* = false */)
                   type == Lexer::Type::dom)
               {
                 Eval e;
-                e.addSource (domSource);
+                e.addSource (context.dom);
                 e.addSource (namedDates);
-                contextTask = *this;
 
                 Variant v;
-                e.evaluateInfixExpression (value, v);
+                e.evaluateInfixExpression (value, *this, v);
                 addTag ((std::string) v);
                 context.debug (label + "tags <-- '" + (std::string) v + "' <-- '" + tag + "'");
               }
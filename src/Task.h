@@ -34,15 +34,15 @@
 #include <time.h>
 #include <JSON.h>
 
-class Task : public std::map <std::string, std::string>
+class Task
 {
 public:
   static std::string defaultProject;
   static std::string defaultDue;
+  static std::map <std::string, std::string> defaultUDAs; // name -> default
   static bool searchCaseSensitive;
   static bool regex;
   static std::map <std::string, std::string> attributes;  // name -> type
-  static std::map <std::string, float> coefficients;
   static std::map <std::string, std::vector <std::string>> customOrder;
   static float urgencyProjectCoefficient;
   static float urgencyActiveCoefficient;
@@ -55,19 +55,61 @@ public:
   static float urgencyBlockingCoefficient;
   static float urgencyAgeCoefficient;
   static float urgencyAgeMax;
+  static bool urgencyInherit;
+
+  // A tag-, project-, keyword- or UDA-specific urgency coefficient, compiled
+  // from its configuration variable name: the tag, project, keyword or UDA it
+  // applies to, and for urgency.uda.<name>.<value>.coefficient, the value.
+  class UrgencyRule
+  {
+  public:
+    std::string _name;
+    std::string _value;
+    bool        _valued;
+    float       _coefficient;
+  };
+
+  static std::vector <UrgencyRule> urgencyUDARules;
+  static std::vector <UrgencyRule> urgencyKeywordRules;
+  static std::vector <UrgencyRule> urgencyProjectRules;
+  static std::vector <UrgencyRule> urgencyTagRules;
+
+  // Iterates over the attributes in name order, as (name, value) pairs.
+  class const_iterator
+  {
+  public:
+    const_iterator (const Task*, unsigned int, std::map <std::string, std::string>::const_iterator);
+    std::pair <const std::string&, const std::string&> operator* () const;
+    const_iterator& operator++ ();
+    bool operator== (const const_iterator&) const;
+    bool operator!= (const const_iterator&) const;
+
+  private:
+    bool interned () const;
+
+  private:
+    const Task*                                         _task;
+    unsigned int                                        _attribute;
+    std::map <std::string, std::string>::const_iterator _extra;
+  };
+
+  static void internAttributes ();
 
 public:
   Task ();                       // Default constructor
   Task (const Task&);            // Copy constructor
   Task& operator= (const Task&); // Assignment operator
   bool operator== (const Task&); // Comparison operator
+  bool operator!= (const Task&); // Comparison operator
   Task (const std::string&);     // Parse
   Task (const json::object*);    // Parse
   ~Task ();                      // Destructor
 
   void parse (const std::string&);
+  void parseFF4 (const char*, size_t);
   std::string composeF4 () const;
   std::string composeJSON (bool decorate = false) const;
+  void composeJSON (std::string&, bool decorate = false) const;
 
   // Status values.
   enum status {pending, completed, deleted, recurring, waiting};
@@ -102,6 +144,11 @@ public:
   void set (const std::string&, int);
   void remove (const std::string&);
 
+  const_iterator begin () const;
+  const_iterator end () const;
+  size_t size () const;
+  void clear ();
+
 #ifdef PRODUCT_TASKWARRIOR
   bool is_ready () const;
   bool is_due () const;
@@ -155,6 +202,27 @@ public:
   enum modType {modReplace, modPrepend, modAppend, modAnnotate};
   void modify (modType, bool text_required = false);
 
+private:
+  // An attribute with an interned name is stored by slot, and if it is a date
+  // or a number, also stored parsed.
+  class Attribute
+  {
+  public:
+    unsigned short _slot;
+    union
+    {
+      time_t       _date;
+      float        _number;
+    };
+    std::string    _value;
+  };
+
+  static int slot (const std::string&);
+  const std::string* lookup (const std::string&) const;
+  const Attribute* lookup (int) const;
+  void store (const std::string&, std::string);
+  void erase (const std::string&);
+
 private:
   int determineVersion (const std::string&);
   void parseJSON (const std::string&);
@@ -176,6 +244,10 @@ public:
   float urgency_due () const;
   float urgency_blocking () const;
   float urgency_age () const;
+
+private:
+  std::vector <Attribute>             _attributes;  // Interned, in name order
+  std::map <std::string, std::string> _extra;       // Everything else
 };
 
 #endif
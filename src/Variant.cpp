@@ -918,7 +918,7 @@ bool Variant::operator_match (const Variant& other, const Task& task) const
 
   if (searchUsingRegex)
   {
-    RX r (pattern, searchCaseSensitive);
+    RX& r = RX::cached (pattern, searchCaseSensitive);
     if (r.match (left._string))
       return true;
 
@@ -1780,7 +1780,8 @@ Variant::operator std::string () const
 
   case type_date:
     {
-      struct tm* t = localtime (&_date);
+      struct tm parts;
+      struct tm* t = localtime_r (&_date, &parts);
 
       std::stringstream s;
       s.width (4);
@@ -146,19 +146,20 @@ public:
   Chart& operator= (const Chart&);   // Unimplemented
   ~Chart ();
 
-  void scan (std::vector <Task>&);
+  void scan (const TDB2Snapshot&);
   std::string render ();
 
 private:
   void generateBars ();
   void optimizeGrid ();
   Date quantize (const Date&);
+  int find (time_t) const;
+  time_t span (std::vector <int>&, time_t, time_t) const;
 
-  Date increment (const Date&);
   Date decrement (const Date&);
   void maxima ();
   void yLabels (std::vector <int>&);
-  void calculateRates (std::vector <time_t>&);
+  void calculateRates ();
   unsigned round_up_to (unsigned, unsigned);
   unsigned burndown_size (unsigned);
 
@@ -172,7 +173,8 @@ public:
   std::vector <int> _labels;      // Y-axis labels
   int _estimated_bars;            // Estimated bar count
   int _actual_bars;               // Calculated bar count
-  std::map <time_t, Bar> _bars;   // Epoch-indexed set of bars
+  std::vector <Bar> _bars;        // Bars, earliest first
+  std::vector <time_t> _epochs;   // Start of each bar's period
   Date _earliest;                 // Date of earliest estimated bar
   int _carryover_done;            // Number of 'done' tasks prior to chart range
   char _period;                   // D, W, M
@@ -221,58 +223,45 @@ Chart::~Chart ()
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Chart::scan (std::vector <Task>& tasks)
+// A task is pending, then started, then done, each over a run of consecutive
+// periods.  Rather than visiting every period of every run, the first bar of a
+// run is marked +1, and the bar after it -1, so that the count for each bar is
+// the running total of the marks up to it.
+void Chart::scan (const TDB2Snapshot& snapshot)
 {
   generateBars ();
 
   // Not quantized, so that "while (xxx < now)" is inclusive.
-  Date now;
+  time_t now = Date ().toEpoch ();
+  time_t earliest = _earliest.toEpoch ();
 
-  time_t epoch;
-  for (auto& task : tasks)
+  std::vector <int> pending (_bars.size () + 1, 0);
+  std::vector <int> started (_bars.size () + 1, 0);
+  std::vector <int> done    (_bars.size () + 1, 0);
+
+  for (size_t i = 0; i < snapshot.size (); ++i)
   {
     // The entry date is when the counting starts.
-    Date from = quantize (Date (task.get_date ("entry")));
-    epoch = from.toEpoch ();
+    time_t from = quantize (Date (snapshot._entry[i])).toEpoch ();
 
-    if (_bars.find (epoch) != _bars.end ())
-      ++_bars[epoch]._added;
+    int bar = find (from);
+    if (bar != -1)
+      ++_bars[bar]._added;
 
     // e-->   e--s-->
     // ppp>   pppsss>
-    Task::status status = task.getStatus ();
+    Task::status status = snapshot._status[i];
     if (status == Task::pending ||
         status == Task::waiting)
     {
-      if (task.has ("start"))
+      if (snapshot._start[i])
       {
-        Date start = quantize (Date (task.get_date ("start")));
-        while (from < start)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-
-        while (from < now)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._started;
-          from = increment (from);
-        }
+        time_t start = quantize (Date (snapshot._start[i])).toEpoch ();
+        from = span (pending, from, start);
+        span (started, from, now);
       }
       else
-      {
-        while (from < now)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-      }
+        span (pending, from, now);
     }
 
     // e--C   e--s--C
@@ -280,66 +269,30 @@ void Chart::scan (std::vector <Task>& tasks)
     else if (status == Task::completed)
     {
       // Truncate history so it starts at 'earliest' for completed tasks.
-      Date end = quantize (Date (task.get_date ("end")));
-      epoch = end.toEpoch ();
+      time_t end = quantize (Date (snapshot._end[i])).toEpoch ();
 
-      if (_bars.find (epoch) != _bars.end ())
-        ++_bars[epoch]._removed;
+      bar = find (end);
+      if (bar != -1)
+        ++_bars[bar]._removed;
 
       // Maintain a running total of 'done' tasks that are off the left of the
       // chart.
-      if (end < _earliest)
+      if (end < earliest)
       {
         ++_carryover_done;
         continue;
       }
 
-      if (task.has ("start"))
+      if (snapshot._start[i])
       {
-        Date start = quantize (Date (task.get_date ("start")));
-        while (from < start)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-
-        while (from < end)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._started;
-          from = increment (from);
-        }
-
-        while (from < now)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._done;
-          from = increment (from);
-        }
+        time_t start = quantize (Date (snapshot._start[i])).toEpoch ();
+        from = span (pending, from, start);
+        from = span (started, from, end);
       }
       else
-      {
-        Date end = quantize (Date (task.get_date ("end")));
-        while (from < end)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-
-        while (from < now)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._done;
-          from = increment (from);
-        }
-      }
+        from = span (pending, from, end);
+
+      span (done, from, now);
     }
 
     // e--D   e--s--D
@@ -347,51 +300,65 @@ void Chart::scan (std::vector <Task>& tasks)
     else if (status == Task::deleted)
     {
       // Skip old deleted tasks.
-      Date end = quantize (Date (task.get_date ("end")));
-      epoch = end.toEpoch ();
-      if (_bars.find (epoch) != _bars.end ())
-        ++_bars[epoch]._removed;
+      time_t end = quantize (Date (snapshot._end[i])).toEpoch ();
 
-      if (end < _earliest)
+      bar = find (end);
+      if (bar != -1)
+        ++_bars[bar]._removed;
+
+      if (end < earliest)
         continue;
 
-      if (task.has ("start"))
+      if (snapshot._start[i])
       {
-        Date start = quantize (Date (task.get_date ("start")));
-        while (from < start)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-
-        while (from < end)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._started;
-          from = increment (from);
-        }
+        time_t start = quantize (Date (snapshot._start[i])).toEpoch ();
+        from = span (pending, from, start);
+        span (started, from, end);
       }
       else
-      {
-        Date end = quantize (Date (task.get_date ("end")));
-        while (from < end)
-        {
-          epoch = from.toEpoch ();
-          if (_bars.find (epoch) != _bars.end ())
-            ++_bars[epoch]._pending;
-          from = increment (from);
-        }
-      }
+        span (pending, from, end);
     }
   }
 
+  // Accumulate the marks.
+  int pending_total = 0;
+  int started_total = 0;
+  int done_total    = 0;
+  for (unsigned int b = 0; b < _bars.size (); ++b)
+  {
+    _bars[b]._pending = (pending_total += pending[b]);
+    _bars[b]._started = (started_total += started[b]);
+    _bars[b]._done    = (done_total    += done[b]);
+  }
+
   // Size the data.
   maxima ();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// The bar of the period that starts at 'epoch', or -1 if there is none.
+int Chart::find (time_t epoch) const
+{
+  auto i = std::lower_bound (_epochs.begin (), _epochs.end (), epoch);
+  if (i != _epochs.end () && *i == epoch)
+    return i - _epochs.begin ();
+
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Marks the bars of the periods from 'from' up to, but excluding 'to', and
+// returns the start of the next run, which is the later of the two.
+time_t Chart::span (std::vector <int>& marks, time_t from, time_t to) const
+{
+  if (from >= to)
+    return from;
+
+  marks[std::lower_bound (_epochs.begin (), _epochs.end (), from) - _epochs.begin ()] += 1;
+  marks[std::lower_bound (_epochs.begin (), _epochs.end (), to)   - _epochs.begin ()] -= 1;
+  return to;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Graph should render like this:
 //   +---------------------------------------------------------------------+
@@ -489,15 +456,9 @@ std::string Chart::render ()
   _grid.replace (LOC (_height - 6, _max_label + 2), _graph_width, std::string (_graph_width, '-'));
 
   // Draw x-axis labels.
-  std::vector <time_t> bars_in_sequence;
-  for (auto& bar : _bars)
-    bars_in_sequence.push_back (bar.first);
-
-  std::sort (bars_in_sequence.begin (), bars_in_sequence.end ());
   std::string _major_label;
-  for (auto& seq : bars_in_sequence)
+  for (auto& bar : _bars)
   {
-    Bar bar = _bars[seq];
 
     // If it fits within the allowed space.
     if (bar._offset < _actual_bars)
@@ -512,9 +473,8 @@ std::string Chart::render ()
   }
 
   // Draw bars.
-  for (auto& seq : bars_in_sequence)
+  for (auto& bar : _bars)
   {
-    Bar bar = _bars[seq];
 
     // If it fits within the allowed space.
     if (bar._offset < _actual_bars)
@@ -535,7 +495,7 @@ std::string Chart::render ()
   }
 
   // Draw rates.
-  calculateRates (bars_in_sequence);
+  calculateRates ();
   char rate[12];
   if (_find_rate != 0.0)
     sprintf (rate, "%.1f/d", _find_rate);
@@ -617,59 +577,6 @@ Date Chart::quantize (const Date& input)
   return input;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-Date Chart::increment (const Date& input)
-{
-  // Move to the next period.
-  int d = input.day ();
-  int m = input.month ();
-  int y = input.year ();
-
-  int days;
-
-  switch (_period)
-  {
-  case 'D':
-    if (++d > Date::daysInMonth (m, y))
-    {
-      d = 1;
-
-      if (++m == 13)
-      {
-        m = 1;
-        ++y;
-      }
-    }
-    break;
-
-  case 'W':
-    d += 7;
-    days = Date::daysInMonth (m, y);
-    if (d > days)
-    {
-      d -= days;
-
-      if (++m == 13)
-      {
-        m = 1;
-        ++y;
-      }
-    }
-    break;
-
-  case 'M':
-    d = 1;
-    if (++m == 13)
-    {
-      m = 1;
-      ++y;
-    }
-    break;
-  }
-
-  return Date (m, d, y, 0, 0, 0);
-}
-
 ////////////////////////////////////////////////////////////////////////////////
 Date Chart::decrement (const Date& input)
 {
@@ -721,10 +628,12 @@ Date Chart::decrement (const Date& input)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Do '_bars[epoch] = Bar' for every bar that may appear on a chart.
+// Creates every bar that may appear on a chart, earliest first.
 void Chart::generateBars ()
 {
   Bar bar;
+  _bars.assign (std::max (_estimated_bars, 0), bar);
+  _epochs.assign (_bars.size (), 0);
 
   // Determine the last bar date.
   Date cursor;
@@ -770,7 +679,8 @@ void Chart::generateBars ()
     }
 
     bar._offset = i;
-    _bars[cursor.toEpoch ()] = bar;
+    _bars[_estimated_bars - i - 1] = bar;
+    _epochs[_estimated_bars - i - 1] = cursor.toEpoch ();
 
     // Record the earliest date, for use as a cutoff when scanning data.
     _earliest = cursor;
@@ -789,9 +699,9 @@ void Chart::maxima ()
   for (auto& bar : _bars)
   {
     // Determine _max_label.
-    int total = bar.second._pending +
-                bar.second._started +
-                bar.second._done    +
+    int total = bar._pending +
+                bar._started +
+                bar._done    +
                 _carryover_done;
 
     // Determine _max_value.
@@ -823,15 +733,15 @@ void Chart::yLabels (std::vector <int>& labels)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void Chart::calculateRates (std::vector <time_t>& sequence)
+void Chart::calculateRates ()
 {
   // If there are no current pending tasks, then it is meaningless to find
   // rates or estimated completion date.
-  if (_bars[sequence.back ()]._pending == 0)
+  if (_bars.back ()._pending == 0)
     return;
 
   // Calculate how many items we have.
-  int quantity = (int) sequence.size ();
+  int quantity = (int) _bars.size ();
   int half     = quantity / 2;
   int quarter  = quantity / 4;
 
@@ -869,16 +779,16 @@ void Chart::calculateRates (std::vector <time_t>& sequence)
   int total_removed_50 = 0;
   int total_removed_75 = 0;
 
-  for (unsigned int i = half; i < sequence.size (); ++i)
+  for (unsigned int i = half; i < _bars.size (); ++i)
   {
-    total_added_50 += _bars[sequence[i]]._added;
-    total_removed_50 += _bars[sequence[i]]._removed;
+    total_added_50 += _bars[i]._added;
+    total_removed_50 += _bars[i]._removed;
   }
 
-  for (unsigned int i = half + quarter; i < sequence.size (); ++i)
+  for (unsigned int i = half + quarter; i < _bars.size (); ++i)
   {
-    total_added_75 += _bars[sequence[i]]._added;
-    total_removed_75 += _bars[sequence[i]]._removed;
+    total_added_75 += _bars[i]._added;
+    total_removed_75 += _bars[i]._removed;
   }
 
   float find_rate_50 = 1.0 * total_added_50 / half_days;
@@ -931,7 +841,7 @@ void Chart::calculateRates (std::vector <time_t>& sequence)
   // Estimate completion
   if (_fix_rate > _find_rate)
   {
-    int current_pending = _bars[sequence.back ()]._pending;
+    int current_pending = _bars.back ()._pending;
     int remaining_days = (int) (current_pending / (_fix_rate - _find_rate));
 
     Date now;
@@ -1038,9 +948,12 @@ int CmdBurndownMonthly::execute (std::string& output)
   std::vector <Task> filtered;
   filter.subset (filtered);
 
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
+
   // Create a chart, scan the tasks, then render.
   Chart chart ('M');
-  chart.scan (filtered);
+  chart.scan (snapshot);
   output = chart.render ();
   return rc;
 }
@@ -1072,9 +985,12 @@ int CmdBurndownWeekly::execute (std::string& output)
   std::vector <Task> filtered;
   filter.subset (filtered);
 
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
+
   // Create a chart, scan the tasks, then render.
   Chart chart ('W');
-  chart.scan (filtered);
+  chart.scan (snapshot);
   output = chart.render ();
   return rc;
 }
@@ -1106,9 +1022,12 @@ int CmdBurndownDaily::execute (std::string& output)
   std::vector <Task> filtered;
   filter.subset (filtered);
 
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
+
   // Create a chart, scan the tasks, then render.
   Chart chart ('D');
-  chart.scan (filtered);
+  chart.scan (snapshot);
   output = chart.render ();
   return rc;
 }
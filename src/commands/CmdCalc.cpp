@@ -62,7 +62,7 @@ int CmdCalc::execute (std::string& output)
 
   // Create an evaluator with DOM access.
   Eval e;
-  e.addSource (domSource);
+  e.addSource (context.dom);
   e.addSource (namedDates);
   e.debug (context.config.getBoolean ("debug"));
 
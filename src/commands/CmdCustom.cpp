@@ -97,6 +97,11 @@ int CmdCustom::execute (std::string& output)
   std::vector <Task> filtered;
   filter.subset (filtered);
 
+  // Report output can be limited by rows or lines.
+  int maxrows = 0;
+  int maxlines = 0;
+  context.getLimits (maxrows, maxlines);
+
   std::vector <int> sequence;
   if (sortOrder.size () &&
       sortOrder[0] == "none")
@@ -117,9 +122,16 @@ int CmdCustom::execute (std::string& output)
     for (unsigned int i = 0; i < filtered.size (); ++i)
       sequence.push_back (i);
 
-    // Sort the tasks.
+    // Sort the tasks.  No more tasks can be shown than there are rows, or
+    // lines, so only that many need be sorted.
     if (sortOrder.size ())
-      sort_tasks (filtered, sequence, reportSort);
+    {
+      int shown = maxrows;
+      if (maxlines > 0 && (shown <= 0 || maxlines < shown))
+        shown = maxlines;
+
+      sort_tasks (filtered, sequence, reportSort, shown);
+    }
   }
 
   // Configure the view.
@@ -187,11 +199,6 @@ int CmdCustom::execute (std::string& output)
       table_header = 2;  // Dashes use an extra line.
   }
 
-  // Report output can be limited by rows or lines.
-  int maxrows = 0;
-  int maxlines = 0;
-  context.getLimits (maxrows, maxlines);
-
   // Adjust for fluff in the output.
   if (maxlines)
     maxlines -= table_header
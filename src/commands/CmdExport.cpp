@@ -25,6 +25,10 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <cmake.h>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <thread>
 #include <Context.h>
 #include <Filter.h>
 #include <main.h>
@@ -33,6 +37,44 @@
 
 extern Context context;
 
+// Tasks are encoded and written in chunks of this many, one chunk per thread.
+#define TASKS_PER_CHUNK 1000
+
+////////////////////////////////////////////////////////////////////////////////
+// Encodes tasks [first, last) into buffer, each preceded by the separator that
+// follows the task before it.  An exception is kept for the caller to rethrow,
+// as threads cannot pass it on.
+static void composeChunk (
+  const std::vector <Task>& tasks,
+  std::string& buffer,
+  unsigned int first,
+  unsigned int last,
+  bool json_array,
+  std::exception_ptr& error)
+{
+  buffer.clear ();
+
+  try
+  {
+    for (unsigned int i = first; i < last; ++i)
+    {
+      if (i)
+      {
+        if (json_array)
+          buffer += ",";
+        buffer += "\n";
+      }
+
+      tasks[i].composeJSON (buffer, true);
+    }
+  }
+
+  catch (...)
+  {
+    error = std::current_exception ();
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 CmdExport::CmdExport ()
 {
@@ -71,31 +113,54 @@ int CmdExport::execute (std::string& output)
   // Is output contained within a JSON array?
   bool json_array = context.config.getBoolean ("json.array");
 
-  // Compose output.
+  // Compose output, which is written as it is composed, rather than held in
+  // output, a chunk at a time.  Chunks are encoded on several threads at once,
+  // unless urgency is inherited, which only one thread may compute, and written
+  // in order.  The buffers are reused for each round of chunks.
   if (json_array)
-    output += "[\n";
+    std::cout << "[\n";
 
-  int counter = 0;
-  for (auto task = filtered.begin (); task != filtered.end (); ++task)
+  unsigned int count = filtered.size ();
+  if (limit && (unsigned int) limit < count)
+    count = limit;
+
+  unsigned int threads = 1;
+  if (! Task::urgencyInherit)
+    threads = std::min (std::max (std::thread::hardware_concurrency (), 1u),
+                        std::max (count / TASKS_PER_CHUNK, 1u));
+
+  std::vector <std::string> buffers (threads);
+  for (unsigned int round = 0; round < count; round += threads * TASKS_PER_CHUNK)
   {
-    if (task != filtered.begin ())
-      {
-        if (json_array)
-          output += ",";
-        output += "\n";
-      }
+    std::vector <std::exception_ptr> errors (threads);
+
+    std::vector <std::thread> workers;
+    for (unsigned int i = 1; i < threads; ++i)
+    {
+      unsigned int first = std::min (round + i * TASKS_PER_CHUNK, count);
+      workers.push_back (std::thread (composeChunk, std::cref (filtered), std::ref (buffers[i]),
+                                      first, std::min (first + TASKS_PER_CHUNK, count),
+                                      json_array, std::ref (errors[i])));
+    }
+
+    composeChunk (filtered, buffers[0], round, std::min (round + TASKS_PER_CHUNK, count), json_array, errors[0]);
+
+    for (auto& worker : workers)
+      worker.join ();
 
-    output += task->composeJSON (true);
+    for (auto& error : errors)
+      if (error)
+        std::rethrow_exception (error);
 
-    if (limit && ++counter >= limit)
-      break;
+    for (auto& buffer : buffers)
+      std::cout << buffer;
   }
 
   if (filtered.size ())
-    output += "\n";
+    std::cout << "\n";
 
   if (json_array)
-    output += "]\n";
+    std::cout << "]\n";
 
   return rc;
 }
@@ -37,69 +37,108 @@
 extern Context context;
 
 ////////////////////////////////////////////////////////////////////////////////
-CmdHistoryMonthly::CmdHistoryMonthly ()
-{
-  _keyword               = "history.monthly";
-  _usage                 = "task <filter> history.monthly";
-  _description           = STRING_CMD_HISTORY_USAGE_M;
-  _read_only             = true;
-  _displays_id           = false;
-  _needs_gc              = false;
-  _uses_context          = true;
-  _accepts_filter        = true;
-  _accepts_modifications = false;
-  _accepts_miscellaneous = false;
-  _category              = Command::Category::graphs;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-int CmdHistoryMonthly::execute (std::string& output)
+// Counts the tasks added, completed and deleted in each period, as given by the
+// start of the period of each date.  The tallies of completed.data stand in for
+// the tasks they count, where the filter allows.
+static void countTasks (
+  Date (Date::*period) () const,
+  std::map <time_t, int>& groups,
+  std::map <time_t, int>& addedGroup,
+  std::map <time_t, int>& completedGroup,
+  std::map <time_t, int>& deletedGroup)
 {
-  int rc = 0;
-
-  std::map <time_t, int> groups;          // Represents any month with data
-  std::map <time_t, int> addedGroup;      // Additions by month
-  std::map <time_t, int> completedGroup;  // Completions by month
-  std::map <time_t, int> deletedGroup;    // Deletions by month
-
-  // Apply filter.
   handleRecurrence ();
   Filter filter;
   std::vector <Task> filtered;
-  filter.subset (filtered);
+  std::vector <TF2Tally> tallies;
+  filter.subsetTallied (filtered, tallies);
 
-  for (auto& task : filtered)
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
+
+  for (size_t i = 0; i < snapshot.size (); ++i)
   {
-    Date entry (task.get_date ("entry"));
+    Date entry (snapshot._entry[i]);
 
     Date end;
-    if (task.has ("end"))
-      end = Date (task.get_date ("end"));
+    if (snapshot._end[i])
+      end = Date (snapshot._end[i]);
 
-    time_t epoch = entry.startOfMonth ().toEpoch ();
+    time_t epoch = (entry.*period) ().toEpoch ();
     groups[epoch] = 0;
 
     // Every task has an entry date, but exclude templates.
-    if (task.getStatus () != Task::recurring)
+    Task::status status = snapshot._status[i];
+    if (status != Task::recurring)
       ++addedGroup[epoch];
 
     // All deleted tasks have an end date.
-    if (task.getStatus () == Task::deleted)
+    if (status == Task::deleted)
     {
-      epoch = end.startOfMonth ().toEpoch ();
+      epoch = (end.*period) ().toEpoch ();
       groups[epoch] = 0;
       ++deletedGroup[epoch];
     }
 
     // All completed tasks have an end date.
-    else if (task.getStatus () == Task::completed)
+    else if (status == Task::completed)
     {
-      epoch = end.startOfMonth ().toEpoch ();
+      epoch = (end.*period) ().toEpoch ();
       groups[epoch] = 0;
       ++completedGroup[epoch];
     }
   }
 
+  // Tallied tasks are all either completed or deleted, and months fall within
+  // any longer period.
+  for (auto& row : tallies)
+  {
+    time_t epoch = (Date (row._entry).*period) ().toEpoch ();
+    groups[epoch] = 0;
+    addedGroup[epoch] += row._count;
+
+    Date end;
+    if (row._end)
+      end = Date (row._end);
+
+    epoch = (end.*period) ().toEpoch ();
+    groups[epoch] = 0;
+    if (row._status == "deleted")
+      deletedGroup[epoch] += row._count;
+    else
+      completedGroup[epoch] += row._count;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CmdHistoryMonthly::CmdHistoryMonthly ()
+{
+  _keyword               = "history.monthly";
+  _usage                 = "task <filter> history.monthly";
+  _description           = STRING_CMD_HISTORY_USAGE_M;
+  _read_only             = true;
+  _displays_id           = false;
+  _needs_gc              = false;
+  _uses_context          = true;
+  _accepts_filter        = true;
+  _accepts_modifications = false;
+  _accepts_miscellaneous = false;
+  _category              = Command::Category::graphs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int CmdHistoryMonthly::execute (std::string& output)
+{
+  int rc = 0;
+
+  std::map <time_t, int> groups;          // Represents any month with data
+  std::map <time_t, int> addedGroup;      // Additions by month
+  std::map <time_t, int> completedGroup;  // Completions by month
+  std::map <time_t, int> deletedGroup;    // Deletions by month
+
+  // Apply filter.
+  countTasks (&Date::startOfMonth, groups, addedGroup, completedGroup, deletedGroup);
+
   // Now build the view.
   ViewText view;
   view.width (context.getWidth ());
@@ -225,42 +264,7 @@ int CmdHistoryAnnual::execute (std::string& output)
   std::map <time_t, int> deletedGroup;    // Deletions by month
 
   // Apply filter.
-  handleRecurrence ();
-  Filter filter;
-  std::vector <Task> filtered;
-  filter.subset (filtered);
-
-  for (auto& task : filtered)
-  {
-    Date entry (task.get_date ("entry"));
-
-    Date end;
-    if (task.has ("end"))
-      end = Date (task.get_date ("end"));
-
-    time_t epoch = entry.startOfYear ().toEpoch ();
-    groups[epoch] = 0;
-
-    // Every task has an entry date, but exclude templates.
-    if (task.getStatus () != Task::recurring)
-      ++addedGroup[epoch];
-
-    // All deleted tasks have an end date.
-    if (task.getStatus () == Task::deleted)
-    {
-      epoch = end.startOfYear ().toEpoch ();
-      groups[epoch] = 0;
-      ++deletedGroup[epoch];
-    }
-
-    // All completed tasks have an end date.
-    else if (task.getStatus () == Task::completed)
-    {
-      epoch = end.startOfYear ().toEpoch ();
-      groups[epoch] = 0;
-      ++completedGroup[epoch];
-    }
-  }
+  countTasks (&Date::startOfYear, groups, addedGroup, completedGroup, deletedGroup);
 
   // Now build the view.
   ViewText view;
@@ -384,42 +388,7 @@ int CmdGHistoryMonthly::execute (std::string& output)
   std::map <time_t, int> deletedGroup;    // Deletions by month
 
   // Apply filter.
-  handleRecurrence ();
-  Filter filter;
-  std::vector <Task> filtered;
-  filter.subset (filtered);
-
-  for (auto& task : filtered)
-  {
-    Date entry (task.get_date ("entry"));
-
-    Date end;
-    if (task.has ("end"))
-      end = Date (task.get_date ("end"));
-
-    time_t epoch = entry.startOfMonth ().toEpoch ();
-    groups[epoch] = 0;
-
-    // Every task has an entry date, but exclude templates.
-    if (task.getStatus () != Task::recurring)
-      ++addedGroup[epoch];
-
-    // All deleted tasks have an end date.
-    if (task.getStatus () == Task::deleted)
-    {
-      epoch = end.startOfMonth ().toEpoch ();
-      groups[epoch] = 0;
-      ++deletedGroup[epoch];
-    }
-
-    // All completed tasks have an end date.
-    else if (task.getStatus () == Task::completed)
-    {
-      epoch = end.startOfMonth ().toEpoch ();
-      groups[epoch] = 0;
-      ++completedGroup[epoch];
-    }
-  }
+  countTasks (&Date::startOfMonth, groups, addedGroup, completedGroup, deletedGroup);
 
   int widthOfBar = context.getWidth () - 15;   // 15 == strlen ("2008 September ")
 
@@ -584,42 +553,7 @@ int CmdGHistoryAnnual::execute (std::string& output)
   std::map <time_t, int> deletedGroup;    // Deletions by month
 
   // Apply filter.
-  handleRecurrence ();
-  Filter filter;
-  std::vector <Task> filtered;
-  filter.subset (filtered);
-
-  for (auto& task : filtered)
-  {
-    Date entry (task.get_date ("entry"));
-
-    Date end;
-    if (task.has ("end"))
-      end = Date (task.get_date ("end"));
-
-    time_t epoch = entry.startOfYear ().toEpoch ();
-    groups[epoch] = 0;
-
-    // Every task has an entry date, but exclude templates.
-    if (task.getStatus () != Task::recurring)
-      ++addedGroup[epoch];
-
-    // All deleted tasks have an end date.
-    if (task.getStatus () == Task::deleted)
-    {
-      epoch = end.startOfYear ().toEpoch ();
-      groups[epoch] = 0;
-      ++deletedGroup[epoch];
-    }
-
-    // All completed tasks have an end date.
-    else if (task.getStatus () == Task::completed)
-    {
-      epoch = end.startOfYear ().toEpoch ();
-      groups[epoch] = 0;
-      ++completedGroup[epoch];
-    }
-  }
+  countTasks (&Date::startOfYear, groups, addedGroup, completedGroup, deletedGroup);
 
   int widthOfBar = context.getWidth () - 5;   // 5 == strlen ("YYYY ")
 
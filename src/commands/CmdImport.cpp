@@ -27,6 +27,8 @@
 #include <cmake.h>
 #include <iostream>
 #include <sstream>
+#include <iterator>
+#include <set>
 #include <Context.h>
 #include <Filter.h>
 #include <text.h>
@@ -38,6 +40,9 @@
 
 extern Context context;
 
+// Tasks are looked up, and imported, in batches of this many.
+#define TASKS_PER_BATCH 1000
+
 ////////////////////////////////////////////////////////////////////////////////
 CmdImport::CmdImport ()
 {
@@ -70,10 +75,8 @@ int CmdImport::execute (std::string& output)
   {
     std::cout << format (STRING_CMD_IMPORT_FILE, "STDIN") << "\n";
 
-    std::string json;
-    std::string line;
-    while (std::getline (std::cin, line))
-      json += line + "\n";
+    std::string json ((std::istreambuf_iterator <char> (std::cin)),
+                      std::istreambuf_iterator <char> ());
 
     if (nontrivial (json))
       count = import (json);
@@ -107,37 +110,17 @@ int CmdImport::import (const std::string& input)
   int count = 0;
   try
   {
-    json::value* root = json::parse (input);
-    if (root)
+    // Input looks like either a single object:
+    //   { ... }
+    // or an array of objects, each validated as soon as it is parsed:
+    //   [ { ... } , { ... } ]
+    json::parse (input, [this, &count] (json::value* element)
     {
-      // Single object parse. Input looks like:
-      //   { ... }
-      if (root->type () == json::j_object)
-      {
-        // For each object element...
-        json::object* root_obj = (json::object*)root;
-        importSingleTask (root_obj);
-        ++count;
-      }
-
-      // Multiple object array. Input looks like:
-      //   [ { ... } , { ... } ]
-      else if (root->type () == json::j_array)
-      {
-        json::array* root_arr = (json::array*)root;
-
-        // For each object element...
-        for (auto& element : root_arr->_data)
-        {
-          // For each object element...
-          json::object* root_obj = (json::object*)element;
-          importSingleTask (root_obj);
-          ++count;
-        }
-      }
+      importSingleTask ((json::object*) element);
+      ++count;
+    });
 
-      delete root;
-    }
+    importBatch ();
   }
 
   // If an exception is caught, then it is because the free-form JSON
@@ -150,6 +133,13 @@ int CmdImport::import (const std::string& input)
   //   { ... }
   catch (std::string& e)
   {
+    // Tasks already parsed from an array are not parsed again.
+    if (count)
+    {
+      importBatch ();
+      throw;
+    }
+
     std::vector <std::string> lines;
     split (lines, input, '\n');
 
@@ -166,6 +156,8 @@ int CmdImport::import (const std::string& input)
         }
       }
     }
+
+    importBatch ();
   }
 
   return count;
@@ -184,53 +176,100 @@ void CmdImport::importSingleTask (json::object* obj)
 
   bool hasGeneratedEnd = not hasExplicitEnd and task.has ("end");
 
-  // Check whether the imported task is new or a modified existing task.
-  Task before;
-  if (context.tdb2.get (task.get ("uuid"), before))
+  _batch.push_back (task);
+  _generatedEntry.push_back (hasGeneratedEntry);
+  _generatedEnd.push_back (hasGeneratedEnd);
+
+  if (_batch.size () >= TASKS_PER_BATCH)
+    importBatch ();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Imports the batched tasks in order, as additions or modifications of
+// existing tasks, which are looked up all at once.  A UUID that is not in
+// lower case, or occurs twice in the batch, is looked up on its own, so that
+// it finds any task it matches only partially, or that was just imported.
+void CmdImport::importBatch ()
+{
+  std::vector <std::string> uuids;
+  for (auto& task : _batch)
+    uuids.push_back (task.get ("uuid"));
+
+  std::vector <Task> found;
+  context.tdb2.get (uuids, found);
+
+  std::map <std::string, Task> existing;
+  for (auto& task : found)
+    existing[task.get ("uuid")] = task;
+
+  std::set <std::string> seen;
+  for (unsigned int i = 0; i < _batch.size (); ++i)
   {
-    // We need to neglect updates from attributes with dynamic defaults
-    // unless they have been explicitly specified on import.
-    //
-    // There are three attributes with dynamic defaults, besides uuid:
-    //   - modified: Ignored in any case.
-    //   - entry: Ignored if generated.
-    //   - end: Ignored if generated.
-
-    // The 'modified' attribute is ignored in any case, since if it
-    // were the only difference between the tasks, it would have been
-    // neglected anyway, since it is bumped on each modification.
-    task.set ("modified", before.get ("modified"));
-
-    // Other generated values are replaced by values from existing task,
-    // so that they are ignored on comparison.
-    if (hasGeneratedEntry)
-      task.set ("entry", before.get ("entry"));
-
-    if (hasGeneratedEnd)
-      task.set ("end", before.get ("end"));
-
-    if (before != task)
+    Task& task = _batch[i];
+
+    // Check whether the imported task is new or a modified existing task.
+    Task before;
+    bool exists;
+    if (seen.insert (uuids[i]).second && uuids[i] == lowerCase (uuids[i]))
+    {
+      auto found = existing.find (uuids[i]);
+      exists = found != existing.end ();
+      if (exists)
+        before = found->second;
+    }
+    else
+      exists = context.tdb2.get (uuids[i], before);
+
+    if (exists)
     {
-      CmdModify modHelper;
-      modHelper.checkConsistency (before, task);
-      modHelper.modifyAndUpdate (before, task);
-      std::cout << " mod  ";
+      // We need to neglect updates from attributes with dynamic defaults
+      // unless they have been explicitly specified on import.
+      //
+      // There are three attributes with dynamic defaults, besides uuid:
+      //   - modified: Ignored in any case.
+      //   - entry: Ignored if generated.
+      //   - end: Ignored if generated.
+
+      // The 'modified' attribute is ignored in any case, since if it
+      // were the only difference between the tasks, it would have been
+      // neglected anyway, since it is bumped on each modification.
+      task.set ("modified", before.get ("modified"));
+
+      // Other generated values are replaced by values from existing task,
+      // so that they are ignored on comparison.
+      if (_generatedEntry[i])
+        task.set ("entry", before.get ("entry"));
+
+      if (_generatedEnd[i])
+        task.set ("end", before.get ("end"));
+
+      if (before != task)
+      {
+        CmdModify modHelper;
+        modHelper.checkConsistency (before, task);
+        modHelper.modifyAndUpdate (before, task);
+        std::cout << " mod  ";
+      }
+      else
+      {
+        std::cout << " skip ";
+      }
     }
     else
     {
-      std::cout << " skip ";
+      context.tdb2.add (task);
+      std::cout << " add  ";
     }
-  }
-  else
-  {
-    context.tdb2.add (task);
-    std::cout << " add  ";
+
+    std::cout << task.get ("uuid")
+              << " "
+              << task.get ("description")
+              << "\n";
   }
 
-  std::cout << task.get ("uuid")
-            << " "
-            << task.get ("description")
-            << "\n";
+  _batch.clear ();
+  _generatedEntry.clear ();
+  _generatedEnd.clear ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -28,6 +28,7 @@
 #define INCLUDED_CMDIMPORT
 
 #include <string>
+#include <vector>
 #include <Command.h>
 #include <JSON.h>
 
@@ -40,6 +41,13 @@ public:
 private:
   int import (const std::string&);
   void importSingleTask (json::object*);
+  void importBatch ();
+
+  // Validated tasks not yet imported, and whether validation generated their
+  // entry and end dates.
+  std::vector <Task> _batch;
+  std::vector <bool> _generatedEntry;
+  std::vector <bool> _generatedEnd;
 };
 
 #endif
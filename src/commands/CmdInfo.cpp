@@ -435,66 +435,33 @@ int CmdInfo::execute (std::string& output)
       urgencyTerm (urgencyDetails, "due",         task.urgency_due (),         Task::urgencyDueCoefficient);
       urgencyTerm (urgencyDetails, "age",         task.urgency_age (),         Task::urgencyAgeCoefficient);
 
-      // Tag, Project- and UDA-specific coefficients.
-      for (auto& var : Task::coefficients)
+      // UDA-, keyword-, project- and tag-specific coefficients.
+      for (auto& rule : Task::urgencyUDARules)
       {
-        if (var.first.substr (0, 13) == "urgency.user.")
+        // urgency.uda.<name>.<value>.coefficient
+        if (rule._valued)
         {
-          // urgency.user.project.<project>.coefficient
-          auto end = std::string::npos;
-          if (var.first.substr (13, 8) == "project." &&
-              (end = var.first.find (".coefficient")) != std::string::npos)
-          {
-            std::string project = var.first.substr (21, end - 21);
-            if (task.get ("project").find (project) == 0)
-              urgencyTerm (urgencyDetails, "PROJECT " + project, 1.0, var.second);
-          }
-
-          // urgency.user.tag.<tag>.coefficient
-          if (var.first.substr (13, 4) == "tag." &&
-              (end = var.first.find (".coefficient")) != std::string::npos)
-          {
-            std::string name = var.first.substr (17, end - 17);
-            if (task.hasTag (name))
-              urgencyTerm (urgencyDetails, "TAG " + name, 1.0, var.second);
-          }
-
-          // urgency.user.keyword.<keyword>.coefficient
-          if (var.first.substr (13, 8) == "keyword." &&
-              (end = var.first.find (".coefficient")) != std::string::npos)
-          {
-            std::string keyword = var.first.substr (21, end - 21);
-            if (task.get ("description").find (keyword) != std::string::npos)
-              urgencyTerm (urgencyDetails, "KEYWORD " + keyword, 1.0, var.second);
-          }
+          if (task.get (rule._name) == rule._value)
+            urgencyTerm (urgencyDetails, "UDA " + rule._name + "." + rule._value, 1.0, rule._coefficient);
         }
 
         // urgency.uda.<name>.coefficient
-        else if (var.first.substr (0, 12) == "urgency.uda.")
-        {
-          // urgency.uda.<name>.coefficient
-          // urgency.uda.<name>.<value>.coefficient
-          auto end = var.first.find (".coefficient");
-          if (end != std::string::npos)
-          {
-            const std::string uda = var.first.substr (12, end - 12);
-            auto dot = uda.find (".");
-            if (dot == std::string::npos)
-            {
-              // urgency.uda.<name>.coefficient
-              if (task.has (uda))
-                urgencyTerm (urgencyDetails, std::string ("UDA ") + uda, 1.0, var.second);
-            }
-            else
-            {
-              // urgency.uda.<name>.<value>.coefficient
-              if (task.get (uda.substr(0, dot)) == uda.substr(dot+1))
-                urgencyTerm (urgencyDetails, std::string ("UDA ") + uda, 1.0, var.second);
-            }
-          }
-        }
+        else if (task.has (rule._name))
+          urgencyTerm (urgencyDetails, "UDA " + rule._name, 1.0, rule._coefficient);
       }
 
+      for (auto& rule : Task::urgencyKeywordRules)
+        if (task.get ("description").find (rule._name) != std::string::npos)
+          urgencyTerm (urgencyDetails, "KEYWORD " + rule._name, 1.0, rule._coefficient);
+
+      for (auto& rule : Task::urgencyProjectRules)
+        if (task.get ("project").find (rule._name) == 0)
+          urgencyTerm (urgencyDetails, "PROJECT " + rule._name, 1.0, rule._coefficient);
+
+      for (auto& rule : Task::urgencyTagRules)
+        if (task.hasTag (rule._name))
+          urgencyTerm (urgencyDetails, "TAG " + rule._name, 1.0, rule._coefficient);
+
       row = urgencyDetails.addRow ();
       urgencyDetails.set (row, 5, rightJustify ("------", 6));
       row = urgencyDetails.addRow ();
@@ -130,6 +130,8 @@ int CmdShow::execute (std::string& output)
     " complete.all.tags"
     " confirmation"
     " context"
+    " data.journal"
+    " data.journal.limit"
     " data.location"
     " dateformat"
     " dateformat.annotation"
@@ -105,14 +105,15 @@ int CmdStats::execute (std::string& output)
   int blockedT      = 0;
   float daysPending = 0.0;
   int descLength    = 0;
-  std::map <std::string, int> allTags;
-  std::map <std::string, int> allProjects;
 
-  for (auto& task : filtered)
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
+
+  for (size_t i = 0; i < snapshot.size (); ++i)
   {
     ++totalT;
 
-    Task::status status = task.getStatus ();
+    Task::status status = snapshot._status[i];
     switch (status)
     {
     case Task::deleted:   ++deletedT;   break;
@@ -122,40 +123,35 @@ int CmdStats::execute (std::string& output)
     case Task::waiting:   ++waitingT;   break;
     }
 
-    if (task.is_blocked)  ++blockedT;
-    if (task.is_blocking) ++blockingT;
+    if (snapshot._blocked[i])  ++blockedT;
+    if (snapshot._blocking[i]) ++blockingT;
 
-    time_t entry = strtol (task.get ("entry").c_str (), NULL, 10);
+    time_t entry = snapshot._entry[i];
     if (entry < earliest) earliest = entry;
     if (entry > latest)   latest   = entry;
 
     if (status == Task::completed)
     {
-      time_t end = strtol (task.get ("end").c_str (), NULL, 10);
+      time_t end = snapshot._end[i];
       daysPending += (end - entry) / 86400.0;
     }
 
     if (status == Task::pending)
       daysPending += (now.toEpoch () - entry) / 86400.0;
 
-    descLength += task.get ("description").length ();
-
-    std::map <std::string, std::string> annotations;
-    task.getAnnotations (annotations);
-    annotationsT += annotations.size ();
+    descLength += snapshot._description_length[i];
+    annotationsT += snapshot._annotations[i];
 
-    std::vector <std::string> tags;
-    task.getTags (tags);
-    if (tags.size ())
+    if (snapshot.tag_count (i))
       ++taggedT;
+  }
 
-    for (auto& tag : tags)
-      allTags[tag] = 0;
-
-    std::string project = task.get ("project");
+  // Every tag and project seen was used by some task.
+  int uniqueTags = snapshot._tag_names.size ();
+  int uniqueProjects = 0;
+  for (auto& project : snapshot._projects)
     if (project != "")
-      allProjects[project] = 0;
-  }
+      ++uniqueProjects;
 
   // Create a table for output.
   ViewText view;
@@ -197,11 +193,11 @@ int CmdStats::execute (std::string& output)
 
   row = view.addRow ();
   view.set (row, 0, STRING_CMD_STATS_UNIQUE_TAGS);
-  view.set (row, 1, (int)allTags.size ());
+  view.set (row, 1, uniqueTags);
 
   row = view.addRow ();
   view.set (row, 0, STRING_CMD_STATS_PROJECTS);
-  view.set (row, 1, (int)allProjects.size ());
+  view.set (row, 1, uniqueProjects);
 
   row = view.addRow ();
   view.set (row, 0, STRING_CMD_STATS_BLOCKED);
@@ -69,13 +69,33 @@ int CmdSummary::execute (std::string& output)
   handleRecurrence ();
   Filter filter;
   std::vector <Task> filtered;
-  filter.subset (filtered);
+  std::vector <TF2Tally> tallies;
+  filter.subsetTallied (filtered, tallies);
+
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (filtered, snapshot);
 
   // Generate unique list of project names from all pending tasks.
   std::map <std::string, bool> allProjects;
-  for (auto& task : filtered)
-    if (showAllProjects || task.getStatus () == Task::pending)
-      allProjects[task.get ("project")] = false;
+  for (size_t i = 0; i < snapshot.size (); ++i)
+    if (showAllProjects || snapshot._status[i] == Task::pending)
+      allProjects[snapshot._projects[snapshot._project[i]]] = false;
+
+  // Tallied tasks are never pending, and so add to the projects only those that
+  // would all be shown.  Their projects are numbered after the snapshot's.
+  std::vector <std::string> names = snapshot._projects;
+  std::map <std::string, size_t> numbers;
+  for (size_t project = 0; project < names.size (); ++project)
+    numbers[names[project]] = project;
+
+  for (auto& row : tallies)
+  {
+    if (showAllProjects)
+      allProjects[row._project] = false;
+
+    if (numbers.insert (std::make_pair (row._project, names.size ())).second)
+      names.push_back (row._project);
+  }
 
   // Initialize counts, sum.
   std::map <std::string, int> countPending;
@@ -93,40 +113,60 @@ int CmdSummary::execute (std::string& output)
     counter        [project.first] = 0;
   }
 
-  // Count the various tasks.
-  for (auto& task : filtered)
+  // Count the various tasks, by project number.
+  auto projects = names.size ();
+  std::vector <int>    projectCounter   (projects, 0);
+  std::vector <int>    projectPending   (projects, 0);
+  std::vector <int>    projectCompleted (projects, 0);
+  std::vector <double> projectEntry     (projects, 0.0);
+
+  for (size_t i = 0; i < snapshot.size (); ++i)
   {
-    std::string project = task.get ("project");
-    std::vector <std::string> projects = extractParents (project);
-    projects.push_back (project);
+    auto project = snapshot._project[i];
+    ++projectCounter[project];
 
-    for (auto& parent : projects)
-      ++counter[parent];
+    time_t entry = snapshot._entry[i];
+    if (snapshot._status[i] == Task::pending ||
+        snapshot._status[i] == Task::waiting)
+    {
+      ++projectPending[project];
+      if (entry)
+        projectEntry[project] += (double) (now - entry);
+    }
 
-    if (task.getStatus () == Task::pending ||
-        task.getStatus () == Task::waiting)
+    else if (snapshot._status[i] == Task::completed)
     {
-      for (auto& parent : projects)
-      {
-        ++countPending[parent];
+      ++projectCompleted[project];
 
-        time_t entry = strtol (task.get ("entry").c_str (), NULL, 10);
-        if (entry)
-          sumEntry[parent] = sumEntry[parent] + (double) (now - entry);
-      }
+      time_t end = snapshot._end[i];
+      if (entry && end)
+        projectEntry[project] += (double) (end - entry);
     }
+  }
 
-    else if (task.getStatus () == Task::completed)
+  for (auto& row : tallies)
+  {
+    auto project = numbers[row._project];
+    projectCounter[project] += row._count;
+    if (row._status == "completed")
     {
-      for (auto& parent : projects)
-      {
-        ++countCompleted[parent];
+      projectCompleted[project] += row._count;
+      projectEntry[project]     += (double) row._age;
+    }
+  }
 
-        time_t entry = strtol (task.get ("entry").c_str (), NULL, 10);
-        time_t end   = strtol (task.get ("end").c_str (), NULL, 10);
-        if (entry && end)
-          sumEntry[parent] = sumEntry[parent] + (double) (end - entry);
-      }
+  // Credit each project's counts to the project, and to its parents.
+  for (size_t project = 0; project < projects; ++project)
+  {
+    std::vector <std::string> parents = extractParents (names[project]);
+    parents.push_back (names[project]);
+
+    for (auto& parent : parents)
+    {
+      counter[parent]        += projectCounter[project];
+      countPending[parent]   += projectPending[project];
+      countCompleted[parent] += projectCompleted[project];
+      sumEntry[parent]       += projectEntry[project];
     }
   }
 
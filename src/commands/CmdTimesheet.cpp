@@ -62,6 +62,8 @@ int CmdTimesheet::execute (std::string& output)
   // Scan the pending tasks.
   handleRecurrence ();
   std::vector <Task> all = context.tdb2.all_tasks ();
+  TDB2Snapshot snapshot;
+  context.tdb2.snapshot (all, snapshot);
 
   // What day of the week does the user consider the first?
   int weekStart = Date::dayOfWeek (context.config.get ("weekstart"));
@@ -109,14 +111,15 @@ int CmdTimesheet::execute (std::string& output)
     Color label (context.config.get ("color.label"));
     completed.colorHeader (label);
 
-    for (auto& task : all)
+    for (size_t i = 0; i < snapshot.size (); ++i)
     {
       // If task completed within range.
-      if (task.getStatus () == Task::completed)
+      if (snapshot._status[i] == Task::completed)
       {
-        Date compDate (task.get_date ("end"));
+        Date compDate (snapshot._end[i]);
         if (compDate >= start && compDate < end)
         {
+          Task& task = all[i];
           Color c;
           if (context.color ())
             autoColorize (task, c);
@@ -165,15 +168,16 @@ int CmdTimesheet::execute (std::string& output)
     started.add (Column::factory ("string",       STRING_COLUMN_LABEL_DESC));
     started.colorHeader (label);
 
-    for (auto& task : all)
+    for (size_t i = 0; i < snapshot.size (); ++i)
     {
       // If task started within range, but not completed withing range.
-      if (task.getStatus () == Task::pending &&
-          task.has ("start"))
+      if (snapshot._status[i] == Task::pending &&
+          snapshot._start[i])
       {
-        Date startDate (task.get_date ("start"));
+        Date startDate (snapshot._start[i]);
         if (startDate >= start && startDate < end)
         {
+          Task& task = all[i];
           Color c;
           if (context.color ())
             autoColorize (task, c);
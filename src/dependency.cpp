@@ -38,29 +38,16 @@
 extern Context context;
 
 ////////////////////////////////////////////////////////////////////////////////
+// Both are lookups in the dependency index that pending.data keeps.
 void dependencyGetBlocked (const Task& task, std::vector <Task>& blocked)
 {
-  std::string uuid = task.get ("uuid");
-
-  auto all = context.tdb2.pending.get_tasks ();
-  for (auto& it : all)
-    if ((it.getStatus () == Task::pending  ||
-         it.getStatus () == Task::waiting) &&
-        it.has ("depends")                 &&
-        it.get ("depends").find (uuid) != std::string::npos)
-      blocked.push_back (it);
+  context.tdb2.pending.get_blocked (task.get ("uuid"), blocked);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void dependencyGetBlocking (const Task& task, std::vector <Task>& blocking)
 {
-  std::string depends = task.get ("depends");
-  if (depends != "")
-    for (auto& it : context.tdb2.pending.get_tasks ())
-      if ((it.getStatus () == Task::pending  ||
-           it.getStatus () == Task::waiting) &&
-          depends.find (it.get ("uuid")) != std::string::npos)
-        blocking.push_back (it);
+  context.tdb2.pending.get_blocking (task, blocking);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
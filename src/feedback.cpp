@@ -49,11 +49,11 @@ std::string taskDifferences (const Task& before, const Task& after)
   // Attributes are all there is, so figure the different attribute names
   // between before and after.
   std::vector <std::string> beforeAtts;
-  for (auto& att : before)
+  for (auto att : before)
     beforeAtts.push_back (att.first);
 
   std::vector <std::string> afterAtts;
-  for (auto& att : after)
+  for (auto att : after)
     afterAtts.push_back (att.first);
 
   std::vector <std::string> beforeOnly;
@@ -143,11 +143,11 @@ std::string taskInfoDifferences (
   // Attributes are all there is, so figure the different attribute names
   // between before and after.
   std::vector <std::string> beforeAtts;
-  for (auto& att : before)
+  for (auto att : before)
     beforeAtts.push_back (att.first);
 
   std::vector <std::string> afterAtts;
-  for (auto& att : after)
+  for (auto att : after)
     afterAtts.push_back (att.first);
 
   std::vector <std::string> beforeOnly;
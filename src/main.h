@@ -73,7 +73,7 @@ std::string onProjectChange (Task&, Task&);
 std::string onExpiration (Task&);
 
 // sort.cpp
-void sort_tasks (std::vector <Task>&, std::vector <int>&, const std::string&);
+void sort_tasks (std::vector <Task>&, std::vector <int>&, const std::string&, int limit = 0);
 
 // legacy.cpp
 void legacyAttributeCheck (const std::string&);
@@ -192,7 +192,7 @@ static void colorizeKeyword (Task& task, const std::string& rule, const Color& b
   // first match.
   else
   {
-    for (auto& it : task)
+    for (auto it : task)
     {
       if (it.first.substr (0, 11) == "annotation_" &&
           find (it.second, rule.substr (14), sensitive) != std::string::npos)
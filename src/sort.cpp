@@ -38,79 +38,58 @@
 
 extern Context context;
 
+// A sort key, decoded once from the sort specification.
+class SortKey
+{
+public:
+  enum class Type { urgency, id, string, date, depends, duration, numeric, uda, other, invalid };
+
+  Type        _type;
+  std::string _field;
+  bool        _ascending;
+  const std::vector <std::string>* _order;   // Custom order of a string UDA.
+};
+
+// The value of one sort key for one task, extracted before sorting so that
+// comparisons need not look up attributes, parse them or consult columns.
+class SortValue
+{
+public:
+  const std::string* _string;                // Raw attribute value.
+  std::string        _text;                  // Dequoted string UDA value.
+  long long          _number;                // id, date, duration, rank.
+  float              _real;                  // numeric UDA.
+};
+
 static std::vector <Task>* global_data = NULL;
-static std::vector <std::string> global_keys;
+static std::vector <SortKey> global_keys;
+static std::vector <SortValue> global_values;
+static std::vector <int> global_ranks;
 static bool sort_compare (int, int);
+static bool sort_compare_stable (int, int);
 
 ////////////////////////////////////////////////////////////////////////////////
-void sort_tasks (
-  std::vector <Task>& data,
-  std::vector <int>& order,
-  const std::string& keys)
+// Decodes the comma-separated sort specification.
+static void decodeKeys (const std::string& keys)
 {
-  context.timer_sort.start ();
-
-  global_data = &data;
-
-  // Split the key defs.
   global_keys.clear ();
-  split (global_keys, keys, ',');
 
-  // Only sort if necessary.
-  if (order.size ())
-    std::stable_sort (order.begin (), order.end (), sort_compare);
-
-  context.timer_sort.stop ();
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// Re-implementation, using direct Task access instead of data copies that
-// require re-parsing.
-//
-// Essentially a static implementation of a dynamic operator<.
-// UDA string values delegate to Variant::operator<.
-static bool sort_compare (int left, int right)
-{
-  std::string field;
-  bool ascending;
-  bool breakIndicator;
-  Column* column;
-  int left_number;
-  int right_number;
-  float left_real;
-  float right_real;
-
-  for (auto& k : global_keys)
+  std::vector <std::string> specs;
+  split (specs, keys, ',');
+  for (auto& spec : specs)
   {
-    context.decomposeSortField (k, field, ascending, breakIndicator);
+    SortKey key;
+    bool breakIndicator;
+    context.decomposeSortField (spec, key._field, key._ascending, breakIndicator);
+    key._order = NULL;
 
-    // Urgency.
+    const std::string& field = key._field;
     if (field == "urgency")
-    {
-      left_real  = (*global_data)[left].urgency ();
-      right_real = (*global_data)[right].urgency ();
+      key._type = SortKey::Type::urgency;
 
-      if (left_real == right_real)
-        continue;
-
-      return ascending ? (left_real < right_real)
-                       : (left_real > right_real);
-    }
-
-    // Number.
     else if (field == "id")
-    {
-      left_number  = (*global_data)[left].id;
-      right_number = (*global_data)[right].id;
-
-      if (left_number == right_number)
-        continue;
-
-      return ascending ? (left_number < right_number)
-                       : (left_number > right_number);
-    }
+      key._type = SortKey::Type::id;
 
-    // String.
     else if (field == "description" ||
              field == "project"     ||
              field == "status"      ||
@@ -119,18 +98,8 @@ static bool sort_compare (int left, int right)
              field == "parent"      ||
              field == "imask"       ||
              field == "mask")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
-      if (left_string == right_string)
-        continue;
-
-      return ascending ? (left_string < right_string)
-                       : (left_string > right_string);
-    }
+      key._type = SortKey::Type::string;
 
-    // Due Date.
     else if (field == "due"      ||
              field == "end"      ||
              field == "entry"    ||
@@ -139,73 +108,170 @@ static bool sort_compare (int left, int right)
              field == "wait"     ||
              field == "modified" ||
              field == "scheduled")
-    {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
-
-      if (left_string != "" && right_string == "")
-        return true;
+      key._type = SortKey::Type::date;
 
-      if (left_string == "" && right_string != "")
-        return false;
+    else if (field == "depends")
+      key._type = SortKey::Type::depends;
 
-      if (left_string == right_string)
-        continue;
+    else if (field == "recur")
+      key._type = SortKey::Type::duration;
 
-      return ascending ? (left_string < right_string)
-                       : (left_string > right_string);
+    else
+    {
+      // UDAs.  An unknown column is only an error if it is needed to break a
+      // tie.
+      auto column = context.columns.find (field);
+      std::string type = column != context.columns.end () && column->second
+                       ? column->second->type ()
+                       : "";
+
+           if (type == "")         key._type = SortKey::Type::invalid;
+      else if (type == "numeric")  key._type = SortKey::Type::numeric;
+      else if (type == "date")     key._type = SortKey::Type::date;
+      else if (type == "duration") key._type = SortKey::Type::duration;
+      else if (type == "string")
+      {
+        // UDA values of type 'string' sort by their custom order, if defined.
+        key._type = SortKey::Type::uda;
+        auto order = Task::customOrder.find (field);
+        if (order != Task::customOrder.end ())
+          key._order = &order->second;
+      }
+      else
+        key._type = SortKey::Type::other;
     }
 
-    // Depends string.
-    else if (field == "depends")
-    {
-      // Raw data is a comma-separated list of uuids
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
+    global_keys.push_back (key);
+  }
+}
 
-      if (left_string == right_string)
-        continue;
+////////////////////////////////////////////////////////////////////////////////
+// Extracts the value of every key for a task.
+static void extractValues (Task& task, SortValue* values)
+{
+  for (auto& key : global_keys)
+  {
+    SortValue& value = *values++;
+    value._string = NULL;
+    value._number = 0;
+    value._real   = 0.0;
 
-      if (left_string == "" && right_string != "")
-        return ascending;
+    switch (key._type)
+    {
+    case SortKey::Type::id:
+      value._number = task.id;
+      break;
 
-      if (left_string != "" && right_string == "")
-        return !ascending;
+    case SortKey::Type::string:
+      value._string = &task.get_ref (key._field);
+      break;
+
+    case SortKey::Type::date:
+      value._string = &task.get_ref (key._field);
+      if (*value._string != "")
+        value._number = task.get_date (key._field);
+      break;
 
+    case SortKey::Type::depends:
       // Sort on the first dependency.
-      left_number  = context.tdb2.id (left_string.substr (0, 36));
-      right_number = context.tdb2.id (right_string.substr (0, 36));
+      value._string = &task.get_ref (key._field);
+      if (*value._string != "")
+        value._number = context.tdb2.id (value._string->substr (0, 36));
+      break;
+
+    case SortKey::Type::duration:
+      value._string = &task.get_ref (key._field);
+      value._number = (time_t) ISO8601p (*value._string);
+      break;
+
+    case SortKey::Type::numeric:
+      value._real = task.get_float (key._field);
+      break;
+
+    case SortKey::Type::uda:
+      value._text = task.get_ref (key._field);
+      Lexer::dequote (value._text);
+      if (key._order)
+        value._number = std::find (key._order->begin (), key._order->end (), value._text) - key._order->begin ();
+      break;
+
+    // Urgency is left to the comparison, as tasks cache it once calculated,
+    // and it is often not needed.
+    case SortKey::Type::urgency:
+    case SortKey::Type::other:
+    case SortKey::Type::invalid:
+      break;
+    }
+  }
+}
 
-      if (left_number == right_number)
-        continue;
+////////////////////////////////////////////////////////////////////////////////
+// If only the first 'limit' tasks are needed, then only they are sorted, and
+// the others dropped from 'order'.
+void sort_tasks (
+  std::vector <Task>& data,
+  std::vector <int>& order,
+  const std::string& keys,
+  int limit /* = 0 */)
+{
+  context.timer_sort.start ();
 
-      return ascending ? (left_number < right_number)
-                       : (left_number > right_number);
-    }
+  // Only sort if necessary.
+  if (order.size () > 1)
+  {
+    global_data = &data;
+    decodeKeys (keys);
 
-    // Duration.
-    else if (field == "recur")
+    unsigned int width = global_keys.size ();
+    global_values.resize (data.size () * width);
+    for (auto& index : order)
+      extractValues (data[index], &global_values[index * width]);
+
+    if (limit > 0 && limit < (int) order.size ())
     {
-      const std::string& left_string  = (*global_data)[left].get_ref  (field);
-      const std::string& right_string = (*global_data)[right].get_ref (field);
+      // A heap of the first 'limit' tasks, in which ties are broken by their
+      // original position, as a stable sort would.
+      global_ranks.resize (data.size ());
+      for (unsigned int i = 0; i < order.size (); ++i)
+        global_ranks[order[i]] = i;
+
+      std::partial_sort (order.begin (), order.begin () + limit, order.end (), sort_compare_stable);
+      order.resize (limit);
+      global_ranks.clear ();
+    }
+    else
+      std::stable_sort (order.begin (), order.end (), sort_compare);
 
-      if (left_string == right_string)
-        continue;
+    global_values.clear ();
+  }
 
-      ISO8601p left_duration (left_string);
-      ISO8601p right_duration (right_string);
-      return ascending ? (left_duration < right_duration)
-                       : (left_duration > right_duration);
-    }
+  context.timer_sort.stop ();
+}
 
-    // UDAs.
-    else if ((column = context.columns[field]) != NULL)
+////////////////////////////////////////////////////////////////////////////////
+// Essentially a static implementation of a dynamic operator<, over the values
+// extracted for each task.
+// UDA string values follow Variant::operator<.
+static bool sort_compare (int left, int right)
+{
+  unsigned int width = global_keys.size ();
+  const SortValue* left_values  = &global_values[left  * width];
+  const SortValue* right_values = &global_values[right * width];
+
+  for (unsigned int k = 0; k < width; ++k)
+  {
+    const SortKey& key = global_keys[k];
+    const SortValue& l = left_values[k];
+    const SortValue& r = right_values[k];
+    bool ascending = key._ascending;
+
+    switch (key._type)
     {
-      std::string type = column->type ();
-      if (type == "numeric")
+    // Urgency.
+    case SortKey::Type::urgency:
       {
-        const float left_real  = strtof (((*global_data)[left].get_ref  (field)).c_str (), NULL);
-        const float right_real = strtof (((*global_data)[right].get_ref (field)).c_str (), NULL);
+        float left_real  = (*global_data)[left].urgency ();
+        float right_real = (*global_data)[right].urgency ();
 
         if (left_real == right_real)
           continue;
@@ -213,56 +279,108 @@ static bool sort_compare (int left, int right)
         return ascending ? (left_real < right_real)
                          : (left_real > right_real);
       }
-      // UDA values of type 'string' are sorted by Variant::operator<.
-      // By setting 'source' to the UDA name, the comparison operator can use
-      // the custom sort order, if defined.
-      else if (type == "string")
-      {
-        Variant l ((*global_data)[left].get_ref  (field));
-        Variant r ((*global_data)[right].get_ref (field));
-        if (l == r)
-          continue;
 
-        l.source (field);
-        r.source (field);
-        return ascending ? (l < r) : (r < l);
-      }
-      else if (type == "date")
-      {
-        const std::string& left_string  = (*global_data)[left].get_ref  (field);
-        const std::string& right_string = (*global_data)[right].get_ref (field);
+    // Numeric UDAs.
+    case SortKey::Type::numeric:
+      if (l._real == r._real)
+        continue;
 
-        if (left_string != "" && right_string == "")
-          return true;
+      return ascending ? (l._real < r._real)
+                       : (l._real > r._real);
 
-        if (left_string == "" && right_string != "")
-          return false;
+    // Number.
+    case SortKey::Type::id:
+      if (l._number == r._number)
+        continue;
 
-        if (left_string == right_string)
-          continue;
+      return ascending ? (l._number < r._number)
+                       : (l._number > r._number);
 
-        return ascending ? (left_string < right_string)
-                         : (left_string > right_string);
-      }
-      else if (type == "duration")
-      {
-        const std::string& left_string  = (*global_data)[left].get_ref  (field);
-        const std::string& right_string = (*global_data)[right].get_ref (field);
+    // String.
+    case SortKey::Type::string:
+      if (*l._string == *r._string)
+        continue;
 
-        if (left_string == right_string)
-          continue;
+      return ascending ? (*l._string < *r._string)
+                       : (*l._string > *r._string);
 
-        ISO8601p left_duration (left_string);
-        ISO8601p right_duration (right_string);
-        return ascending ? (left_duration < right_duration)
-                         : (left_duration > right_duration);
-      }
+    // Dates, which sort after no date in either direction.
+    case SortKey::Type::date:
+      if (*l._string != "" && *r._string == "")
+        return true;
+
+      if (*l._string == "" && *r._string != "")
+        return false;
+
+      if (*l._string == *r._string)
+        continue;
+
+      return ascending ? (l._number < r._number)
+                       : (l._number > r._number);
+
+    // Depends string.
+    case SortKey::Type::depends:
+      if (*l._string == *r._string)
+        continue;
+
+      if (*l._string == "" && *r._string != "")
+        return ascending;
+
+      if (*l._string != "" && *r._string == "")
+        return !ascending;
+
+      if (l._number == r._number)
+        continue;
+
+      return ascending ? (l._number < r._number)
+                       : (l._number > r._number);
+
+    // Duration.
+    case SortKey::Type::duration:
+      if (*l._string == *r._string)
+        continue;
+
+      return ascending ? (l._number < r._number)
+                       : (l._number > r._number);
+
+    // UDA values of type 'string' sort by their custom order, if defined, and
+    // otherwise lexically, with an empty value equal to any other.
+    case SortKey::Type::uda:
+      if (l._text == r._text)
+        continue;
+
+      if (key._order)
+        return ascending ? (l._number < r._number)
+                         : (r._number < l._number);
+
+      if (l._text == "" || r._text == "")
+        return false;
+
+      return ascending ? (l._text < r._text)
+                       : (r._text < l._text);
+
+    case SortKey::Type::other:
+      continue;
+
+    case SortKey::Type::invalid:
+      throw format (STRING_INVALID_SORT_COL, key._field);
     }
-    else
-      throw format (STRING_INVALID_SORT_COL, field);
   }
 
   return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
+// Orders tasks as sort_compare does, or failing that, by original position.
+static bool sort_compare_stable (int left, int right)
+{
+  if (sort_compare (left, right))
+    return true;
+
+  if (sort_compare (right, left))
+    return false;
+
+  return global_ranks[left] < global_ranks[right];
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -28,6 +28,7 @@
 
 import sys
 import os
+import re
 import unittest
 # Ensure python finds the local simpletap module
 sys.path.append(os.path.dirname(os.path.abspath(__file__)))
@@ -55,6 +56,74 @@ class TestCompleted(TestCase):
         self.assertNotIn('three', out)
 
 
+class TestCompletedSummary(TestCase):
+
+    def setUp(self):
+        """Executed before each test in the class"""
+        self.t = Task()
+        self.t("log old project:A end:2000-01-01")
+        self.t("log older project:B end:1999-01-01")
+        self.t("add new project:C")
+        self.t("1 done")
+        self.t("completed")
+        self.index = os.path.join(self.t.datadir, "completed.index")
+
+    def test_summary_written(self):
+        """Verify completed.data is summarized on commit"""
+        self.assertTrue(os.path.exists(self.index))
+        with open(self.index) as f:
+            self.assertEqual(len(f.readlines()), 4)
+
+    def test_summary_filter(self):
+        """Verify a filter on summarized attributes reads only what matches"""
+        code, out, err = self.t("completed end.after:2001-01-01 rc.debug:1")
+        self.assertIn('new', out)
+        self.assertNotIn('old', out)
+        self.assertIn('Read 1 of 3 completed tasks [summary]', err)
+
+        code, out, err = self.t("completed project:A")
+        self.assertIn('old', out)
+        self.assertNotIn('new', out)
+
+    def test_summary_mixed_filter(self):
+        """Verify other terms of the filter are still applied"""
+        code, out, err = self.t("completed end.before:2001-01-01 description:older")
+        self.assertIn('older', out)
+        self.assertNotIn('new', out)
+
+    def test_summary_get_by_uuid(self):
+        """Verify a completed task can be found by UUID through the summary"""
+        with open(os.path.join(self.t.datadir, "completed.data")) as f:
+            line = [l for l in f if 'description:"older"' in l][0]
+            uuid = re.search('uuid:"([^"]+)"', line).group(1)
+
+        code, out, err = self.t("_get {0}.description".format(uuid))
+        self.assertEqual(out.strip(), 'older')
+
+        code, out, err = self.t("{0} info".format(uuid[:8]))
+        self.assertIn('older', out)
+
+    def test_summary_stale(self):
+        """Verify a stale summary is ignored, and rewritten"""
+        with open(os.path.join(self.t.datadir, "completed.data"), "a") as f:
+            f.write('[description:"added" end:"1420070400" entry:"1420070400" status:"completed" uuid:"a0000000-0000-0000-0000-000000000000"]\n')
+
+        code, out, err = self.t("completed end.after:2014-01-01")
+        self.assertIn('added', out)
+
+        with open(self.index) as f:
+            self.assertEqual(len(f.readlines()), 5)
+
+    def test_summary_corrupt(self):
+        """Verify a corrupt summary is ignored"""
+        with open(self.index, "w") as f:
+            f.write("garbage\n")
+
+        code, out, err = self.t("completed end.after:2001-01-01")
+        self.assertIn('new', out)
+        self.assertNotIn('old', out)
+
+
 if __name__ == "__main__":
     from simpletap import TAPTestRunner
     unittest.main(testRunner=TAPTestRunner())
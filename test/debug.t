@@ -76,6 +76,19 @@ class TestDebugMode(TestCase):
         self.assertIn("CLI2::prepareFilter", err)
         self.assertIn("Infix parsed", err)
 
+    def test_debug_selected_output(self):
+        """Verify tasks selected by ID or UUID are looked up, not filtered"""
+        code, out, err = self.t("1,2 one info rc.debug=1")
+        self.assertIn("Filtered 2 tasks --> 1 tasks [selected]", err)
+
+        code, out, err = self.t("_get 2.uuid")
+        self.t("2 done")
+        code, out, err = self.t("{0} info rc.debug=1".format(out.strip()))
+        self.assertIn("Filtered 1 tasks --> 1 tasks [selected]", err)
+
+        code, out, err = self.t("1 or two info rc.debug=1")
+        self.assertIn("[all tasks]", err)
+
     def test_debug_hooks_output(self):
         """Verify debug hooks mode generates interesting output"""
         code, out, err = self.t("list rc.debug.hooks=2")
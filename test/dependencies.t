@@ -144,6 +144,17 @@ class TestDependencies(TestCase):
         code, out, err = self.t("_get 1.tags.BLOCKED")
         self.assertEqual("\n", out)
 
+    def test_blocking_list_order(self):
+        """Check that blocking tasks are listed in ID order"""
+        self.t("add three")
+        self.t("add four dep:3,1,2")
+
+        code, out, err = self.t("_get 4.tags.BLOCKED")
+        self.assertEqual("BLOCKED\n", out)
+
+        code, out, err = self.t("rc.report.deps.columns:id,depends rc.report.deps.sort:id 4 deps")
+        self.assertRegexpMatches(out, "4\s+1 2 3")
+
     def test_chain_repair(self):
         """Check that a broken chain is repaired"""
         self.t("add three")
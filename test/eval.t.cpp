@@ -46,7 +46,7 @@ bool get (const std::string& name, Variant& value)
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest t (52);
+  UnitTest t (62);
 
   // Test the source independently.
   Variant v;
@@ -163,6 +163,69 @@ int main (int argc, char** argv)
   t.is (result.type (), Variant::type_duration, "infix '- 2days' --> duration");
   t.is (result.get_duration (), -86400*2,      "infix '- 2days' --> -86400 * 2");
 
+  // A compiled expression evaluated against several tasks.
+  Eval compiled;
+  compiled.addSource (context.dom);
+  compiled.compileExpression ("id == 3");
+
+  Task three ("[description:\"three\"]");
+  three.id = 3;
+  Task four ("[description:\"four\"]");
+  four.id = 4;
+
+  compiled.evaluateCompiledExpression (three, result);
+  t.is (result.get_bool (), true,              "compiled 'id == 3' --> true for task 3");
+
+  Eval compiled2;
+  compiled2.addSource (get);
+  compiled2.addSource (context.dom);
+  compiled2.compileExpression ("id == 3 and x");
+  compiled2.evaluateCompiledExpression (three, result);
+  t.is (result.get_bool (), true,              "compiled 'id == 3 and x' --> true for task 3");
+  compiled2.evaluateCompiledExpression (four, result);
+  t.is (result.get_bool (), false,             "compiled 'id == 3 and x' --> false for task 4");
+  compiled2.evaluateCompiledExpression (Task (), result);
+  t.is (result.get_bool (), false,             "compiled 'id == 3 and x' --> false for no task");
+
+  // Operations on constants are folded when compiled.
+  Eval compiled3;
+  compiled3.addSource (context.dom);
+  compiled3.compileExpression ("id == 1 + 2 * 1");
+  compiled3.evaluateCompiledExpression (three, result);
+  t.is (result.get_bool (), true,              "compiled 'id == 1 + 2 * 1' --> true for task 3");
+  compiled3.evaluateCompiledExpression (four, result);
+  t.is (result.get_bool (), false,             "compiled 'id == 1 + 2 * 1' --> false for task 4");
+
+  // A constant operation that fails does so only when evaluated.
+  Eval compiled4;
+  compiled4.addSource (context.dom);
+  compiled4.compileExpression ("id == 1 / 0");
+  try
+  {
+    compiled4.evaluateCompiledExpression (three, result);
+    t.fail ("compiled 'id == 1 / 0' --> error");
+  }
+  catch (const std::string&)
+  {
+    t.pass ("compiled 'id == 1 / 0' --> error");
+  }
+
+  Eval compiled5;
+  compiled5.compileExpression ("2 ^ 3");
+  compiled5.evaluateCompiledExpression (result);
+  t.is (result.get_integer (), 8,              "compiled '2 ^ 3' --> 8");
+
+  // Inherited urgency is computed from, and stored in, the pending tasks, so
+  // a filter that reads urgency cannot be evaluated on several threads.
+  Eval compiled6;
+  compiled6.addSource (context.dom);
+  compiled6.compileExpression ("urgency > 1");
+  Task::urgencyInherit = false;
+  t.ok (compiled6.concurrent (),               "compiled 'urgency > 1' --> concurrent");
+  Task::urgencyInherit = true;
+  t.notok (compiled6.concurrent (),            "compiled 'urgency > 1' --> not concurrent with urgency.inherit");
+  Task::urgencyInherit = false;
+
   return 0;
 }
 
@@ -208,6 +208,26 @@ class TestExportCommandLimit(TestCase):
         self.assertNotIn("two", out)
 
 
+class TestExportCommandChunks(TestCase):
+    def setUp(self):
+        self.t = Task()
+        tasks = ['{{"description":"task {0}","status":"pending","entry":"20150101T000000Z",'
+                 '"uuid":"00000000-0000-0000-0000-{0:012d}"}}'.format(i) for i in range(2500)]
+        self.t("import -", input="[\n" + ",\n".join(tasks) + "\n]")
+
+    def test_export_chunks(self):
+        """Verify tasks exported in several chunks are all written, in order"""
+        code, out, err = self.t("export")
+        tasks = json.loads(out)
+        self.assertEqual(len(tasks), 2500)
+        self.assertEqual([t["id"] for t in tasks], list(range(1, 2501)))
+
+        code, out, err = self.t("export limit:1500 rc.json.array:off")
+        lines = out.splitlines()
+        self.assertEqual(len(lines), 1500)
+        self.assertEqual(json.loads(lines[1499])["description"], "task 1499")
+
+
 if __name__ == "__main__":
     from simpletap import TAPTestRunner
     unittest.main(testRunner=TAPTestRunner())
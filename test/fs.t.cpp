@@ -35,7 +35,7 @@ Context context;
 
 int main (int argc, char** argv)
 {
-  UnitTest t (110);
+  UnitTest t (120);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -156,6 +156,32 @@ int main (int argc, char** argv)
   t.ok (f7.remove (),                    "File::remove tmp/file.t.3.txt good");
   t.notok (f7.exists (),                 "File::remove new file no longer exists");
 
+  // bool map (const char*&, size_t&);
+  File::write ("tmp/file.t.map.txt", "one\ntwo\n");
+  File f9 ("tmp/file.t.map.txt");
+  const char* contents = NULL;
+  size_t length = 0;
+  t.ok (f9.map (contents, length),       "File::map tmp/file.t.map.txt good");
+  t.is (std::string (contents, length), "one\ntwo\n", "File::map tmp/file.t.map.txt contents");
+  f9.close ();
+
+  File::write ("tmp/file.t.map.txt", "");
+  t.ok (f9.map (contents, length),       "File::map empty file good");
+  t.ok (contents == NULL && length == 0, "File::map empty file maps nothing");
+  f9.close ();
+  t.ok (f9.remove (),                    "File::remove tmp/file.t.map.txt good");
+
+  // bool sync ();
+  // static bool sync (const std::string&);
+  File f10 ("tmp/file.t.sync.txt");
+  t.notok (f10.sync (),                  "File::sync fails when not open");
+  f10.append ("one\n");
+  t.ok (f10.sync (),                     "File::sync tmp/file.t.sync.txt good");
+  f10.close ();
+  t.ok (File::sync ("tmp"),              "File::sync tmp directory good");
+  t.notok (File::sync ("tmp/missing"),   "File::sync missing file fails");
+  t.ok (f10.remove (),                   "File::remove tmp/file.t.sync.txt good");
+
   // Test permissions.
   File f8 ("tmp/file.t.perm.txt");
   f8.create (0744);
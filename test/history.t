@@ -99,6 +99,55 @@ class TestHistoryAnnual(TestCase):
         self.assertRegexpMatches(out, "\s2.+\s3.+\s3.+")
 
 
+class TestHistoryTallied(TestCase):
+    def setUp(self):
+        """Executed before each test in the class"""
+        self.t = Task()
+        self.data = """[
+{"uuid":"00000000-0000-0000-0000-000000000001","description":"one","project":"A","status":"completed","entry":"20150102T120000Z","end":"20150202T120000Z"},
+{"uuid":"00000000-0000-0000-0000-000000000002","description":"two","project":"A","status":"completed","entry":"20150102T120000Z","end":"20150202T120000Z"},
+{"uuid":"00000000-0000-0000-0000-000000000003","description":"three","project":"B","status":"completed","entry":"20150202T120000Z","end":"20150302T120000Z"},
+{"uuid":"00000000-0000-0000-0000-000000000004","description":"four","project":"B","status":"deleted","entry":"20150302T120000Z","end":"20150302T120000Z"}
+]"""
+        self.t("import -", input=self.data)
+        self.t("completed")
+        self.stats = os.path.join(self.t.datadir, "completed.stats")
+
+    def test_tallies_written(self):
+        """Verify completed.data is tallied, and history counted from the tallies"""
+        code, first, err = self.t("history.monthly")
+        self.assertTrue(os.path.exists(self.stats))
+
+        code, out, err = self.t("history.monthly rc.debug:1")
+        self.assertIn("[tallied]", err)
+        self.assertEqual(first, out)
+        self.assertRegexpMatches(out, "January\s+2\s+0\s+0\s+2")
+        self.assertRegexpMatches(out, "February\s+1\s+2\s+0\s+-1")
+        self.assertRegexpMatches(out, "March\s+1\s+1\s+1\s+-1")
+
+    def test_tallies_filter(self):
+        """Verify a filter on tallied attributes is applied to the tallies"""
+        code, out, err = self.t("project:A history.annual rc.debug:1")
+        self.assertIn("[tallied]", err)
+        self.assertRegexpMatches(out, "2015\s+2\s+2\s+0\s+0")
+
+        code, out, err = self.t("project:A summary rc.summary.all.projects:on")
+        self.assertRegexpMatches(out, "A\s+0\s+.+100%")
+
+        code, out, err = self.t("description:one history.annual rc.debug:1")
+        self.assertNotIn("[tallied]", err)
+        self.assertRegexpMatches(out, "2015\s+1\s+1\s+0\s+0")
+
+    def test_tallies_stale(self):
+        """Verify stale tallies are counted again"""
+        self.t("history.monthly")
+        with open(os.path.join(self.t.datadir, "completed.data"), "a") as f:
+            f.write('[description:"added" end:"1420070400" entry:"1420070400" status:"completed" uuid:"a0000000-0000-0000-0000-000000000000"]\n')
+
+        code, out, err = self.t("history.annual")
+        self.assertRegexpMatches(out, "2015\s+5\s+4\s+1\s+0")
+
+
 if __name__ == "__main__":
     from simpletap import TAPTestRunner
     unittest.main(testRunner=TAPTestRunner())
@@ -233,6 +233,22 @@ class TestImport(TestCase):
         code, out2, err = self.t("export")
         self.assertEqual(out1, out2)
 
+    def test_import_same_task_twice_in_batch(self):
+        """Test import of a task that occurs again, in the same or a later batch"""
+        _tasks = [{"uuid": "a0000000-0000-0000-0000-{0:012d}".format(i),
+                   "description": "task {0}".format(i)} for i in range(1500)]
+        _tasks.append({"uuid": _tasks[1]["uuid"], "description": "again 1"})
+        _tasks.append({"uuid": _tasks[0]["uuid"], "description": "again 0"})
+        _tasks.append({"uuid": _tasks[0]["uuid"].upper(), "description": "again 0"})
+        code, out, err = self.t("import", input=json.dumps(_tasks))
+        self.assertIn(" mod  {0} again 1".format(_tasks[1]["uuid"]), out)
+        self.assertIn(" mod  {0} again 0".format(_tasks[0]["uuid"]), out)
+        self.assertIn(" skip {0} again 0".format(_tasks[0]["uuid"].upper()), out)
+        self.assertIn("Imported 1503 tasks.", err)
+
+        code, out, err = self.t("_unique uuid")
+        self.assertEqual(len(out.split()), 1500)
+
 
 class TestImportExportRoundtrip(TestCase):
     def setUp(self):
@@ -0,0 +1,141 @@
+#!/usr/bin/env python2.7
+# -*- coding: utf-8 -*-
+###############################################################################
+#
+# Copyright 2006 - 2015, Paul Beckingham, Federico Hernandez.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included
+# in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+# OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# http://www.opensource.org/licenses/mit-license.php
+#
+###############################################################################
+
+import sys
+import os
+import unittest
+# Ensure python finds the local simpletap module
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+from basetest import Task, TestCase
+
+
+
+class TestJournal(TestCase):
+    def setUp(self):
+        self.t = Task()
+        self.t.config("data.journal", "on")
+        self.t.config("data.journal.limit", "100")
+        self.pending = os.path.join(self.t.datadir, "pending.data")
+        self.journal = os.path.join(self.t.datadir, "pending.journal")
+
+    def read(self, path):
+        with open(path) as f:
+            return f.read()
+
+    def test_changes_are_journaled(self):
+        """Changes are appended to the journal, not to pending.data"""
+        self.t("add one")
+        self.t("add two")
+        self.t("1 modify +tag")
+        self.assertEqual(self.read(self.pending), "")
+        self.assertEqual(len(self.read(self.journal).splitlines()), 3)
+
+        code, out, err = self.t("_get 1.tags 2.description")
+        self.assertEqual(out, "tag two\n")
+
+    def test_gc_is_journaled(self):
+        """Tasks that GC removes are journaled, and IDs follow"""
+        self.t("add one")
+        self.t("add two")
+        self.t("1 done")
+        self.t("list")
+        self.assertIn("-", self.read(self.journal))
+
+        code, out, err = self.t("_get 1.description")
+        self.assertEqual(out, "two\n")
+
+        code, out, err = self.t("completed")
+        self.assertIn("one", out)
+
+    def test_compaction(self):
+        """The journal is folded into pending.data at the limit"""
+        self.t.config("data.journal.limit", "3")
+        self.t("add one")
+        self.t("add two")
+        self.t("1 modify +tag")
+        self.assertEqual(self.read(self.journal), "")
+        self.assertEqual(len(self.read(self.pending).splitlines()), 2)
+
+        self.t("2 modify +tag")
+        self.assertEqual(len(self.read(self.journal).splitlines()), 1)
+
+        code, out, err = self.t("_get 1.tags 2.tags")
+        self.assertEqual(out, "tag tag\n")
+
+    def test_journaling_off(self):
+        """Turning journaling off folds the journal into pending.data"""
+        self.t("add one")
+        self.t.config("data.journal", "off")
+        self.t("1 modify +tag")
+        self.assertEqual(self.read(self.journal), "")
+        self.assertIn("tag", self.read(self.pending))
+
+    def test_incomplete_record(self):
+        """An incomplete record, as a crash leaves it, is ignored"""
+        self.t("add one")
+        with open(self.journal, "a") as f:
+            f.write('[description:"two" entry:"1')
+
+        self.t("add three")
+        code, out, err = self.t("_unique description")
+        self.assertEqual(out, "one\nthree\n")
+
+
+class TestRewrite(TestCase):
+    def setUp(self):
+        self.t = Task()
+        self.t.config("data.journal", "off")
+        self.t("add one")
+        self.t("add two")
+        self.pending = os.path.join(self.t.datadir, "pending.data")
+
+    def test_mode_is_kept(self):
+        """Rewriting pending.data keeps its permissions"""
+        os.chmod(self.pending, 0o600)
+        self.t("1 modify three")
+        self.assertEqual(os.stat(self.pending).st_mode & 0o777, 0o600)
+
+        code, out, err = self.t("_get 1.description")
+        self.assertEqual(out, "three\n")
+
+    def test_link_is_kept(self):
+        """Rewriting a linked pending.data replaces the file it leads to"""
+        target = os.path.join(self.t.datadir, "elsewhere.data")
+        os.rename(self.pending, target)
+        os.symlink(target, self.pending)
+        self.t("1 modify three")
+        self.assertTrue(os.path.islink(self.pending))
+        self.assertIn("three", open(target).read())
+
+
+if __name__ == "__main__":
+    from simpletap import TAPTestRunner
+    unittest.main(testRunner=TAPTestRunner())
+
+# vim: ai sts=4 et sw=4 ft=python
@@ -27,6 +27,7 @@
 #include <cmake.h>
 #include <iostream>
 #include <stdlib.h>
+#include <vector>
 #include <JSON.h>
 #include <test.h>
 #include <Context.h>
@@ -106,7 +107,7 @@ const char *negative_tests[] =
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest t (NUM_POSITIVE_TESTS + NUM_NEGATIVE_TESTS + 22);
+  UnitTest t (NUM_POSITIVE_TESTS + NUM_NEGATIVE_TESTS + 28);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -179,6 +180,37 @@ int main (int argc, char** argv)
     t.is (encoded[4], '\\',                  "json::encode oneslashslashslashslash[4] -> slashslash");
 
     t.is (json::decode (encoded), "one\\",   "json::decode oneslashslashslashslashslashslashslashslash -> oneslashslashslashslash");
+
+    // Strings are kept as written, escapes and all.
+    json::value* root = json::parse ("{\"a\\\"b\":\"c\\\\\",\"n\":-1.5e2}");
+    json::object* obj = (json::object*) root;
+    t.is (((json::string*) obj->_data["a\\\"b"])->_data, "c\\\\", "json::parse keeps escapes in names and strings");
+    t.is ((double) *(json::number*) obj->_data["n"], -150.0,           "json::parse -1.5e2 -> -150");
+    delete root;
+
+    // Each array element is handed over in turn.
+    std::vector <std::string> elements;
+    json::parse ("[ {\"x\":1}, [2], \"three\" ]", [&elements] (json::value* element)
+    {
+      elements.push_back (element->dump ());
+    });
+    t.is ((int) elements.size (), 3,                    "json::parse callback, 3 elements");
+    t.is (elements[2], "\"three\"",                     "json::parse callback, elements in order");
+
+    int count = 0;
+    json::parse ("{\"x\":1}", [&count] (json::value*) { ++count; });
+    t.is (count, 1,                                     "json::parse callback, top-level object");
+
+    count = 0;
+    try
+    {
+      json::parse ("{\"x\":1} {\"y\":2}", [&count] (json::value*) { ++count; });
+      t.fail ("json::parse callback, extra characters");
+    }
+    catch (const std::string& e)
+    {
+      t.is (count, 0,                                   "json::parse callback, object with extra characters not handed over");
+    }
   }
 
   catch (const std::string& e) {t.diag (e);}
@@ -99,6 +99,27 @@ class TestLimit(TestCase):
         code, out, err = self.t("ls limit:page")
         self.assertIn("30 tasks, truncated to 22 lines", out)
 
+    def test_limit_sort_stable(self):
+        """Verify limit:N shows the first N tasks of the full, stable sort"""
+        self.t.config("report.foo.columns", "description")
+        self.t.config("report.foo.labels",  "Description")
+        self.t.config("report.foo.sort",    "project+")
+        self.t.config("verbose",            "nothing")
+        self.t("add a1 project:B")
+        self.t("add a2 project:A")
+        self.t("add a3 project:B")
+        self.t("add a4 project:A")
+        self.t("add a5 project:A")
+
+        code, out, err = self.t("foo")
+        self.assertEqual(out.split(), ["a2", "a4", "a5", "a1", "a3"])
+
+        code, out, err = self.t("foo limit:4")
+        self.assertEqual(out.split(), ["a2", "a4", "a5", "a1"])
+
+        code, out, err = self.t("foo limit:2")
+        self.assertEqual(out.split(), ["a2", "a4"])
+
 
 if __name__ == "__main__":
     from simpletap import TAPTestRunner
@@ -34,7 +34,7 @@ Context context;
 
 int main (int argc, char** argv)
 {
-  UnitTest ut (26);
+  UnitTest ut (30);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -135,6 +135,13 @@ int main (int argc, char** argv)
   RX r15 ("D[0-9]");
   ut.ok (r15.match (text), text + " =~ /D[0-9]/");
 
+  // Cached expressions are compiled once per pattern and case sensitivity.
+  RX& r16 = RX::cached ("d[0-9]");
+  ut.ok (&r16 == &RX::cached ("d[0-9]"),        "RX::cached reuses the expression");
+  ut.ok (&r16 != &RX::cached ("d[0-9]", false), "RX::cached distinguishes case sensitivity");
+  ut.notok (RX::cached ("d[0-9]").match (text),  text + " !~ /d[0-9]/");
+  ut.ok (RX::cached ("d[0-9]", false).match (text), text + " =~ /d[0-9]/i");
+
   return 0;
 }
 
@@ -34,7 +34,7 @@ Context context;
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest test (23);
+  UnitTest test (38);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -151,6 +151,49 @@ TODO Task::decode
   left.set ("one", "1.0");
   test.notok (left == right, "left == right -> false");
 
+  // Interned attributes are stored by slot, alongside any others, but still
+  // kept in name order.
+  Task early ("[zeta:\"z\" due:\"1000000000\"]");
+  Task::attributes["due"]         = "date";
+  Task::attributes["description"] = "string";
+  Task::attributes["priority"]    = "string";
+  Task::attributes["estimate"]    = "numeric";
+  Task::internAttributes ();
+
+  Task interned ("[priority:\"H\" annotation_1:\"note\" due:\"1000000000\" alpha:\"a\" estimate:\"2.5\" description:\"d\"]");
+  test.is (interned.composeF4 (), "[alpha:\"a\" annotation_1:\"note\" description:\"d\" due:\"1000000000\" estimate:\"2.5\" priority:\"H\"]", "Task::composeF4 interned attributes in name order");
+  test.is ((int) interned.size (), 6, "Task::size counts all attributes");
+  test.ok (interned.get_date ("due") == 1000000000, "Task::get_date interned date");
+  test.is (interned.get_float ("estimate"), 2.5, 0.001, "Task::get_float interned number");
+
+  interned.set ("due", "1000000001");
+  test.ok (interned.get_date ("due") == 1000000001, "Task::set updates interned date");
+
+  interned.remove ("priority");
+  interned.remove ("alpha");
+  test.is (interned.composeF4 (), "[annotation_1:\"note\" description:\"d\" due:\"1000000001\" estimate:\"2.5\"]", "Task::remove interned and other attributes");
+
+  // A task that predates interning keeps working.
+  test.ok (early.get_date ("due") == 1000000000, "Task::get_date attribute set before interning");
+  early.set ("due", "1000000002");
+  test.is (early.composeF4 (), "[due:\"1000000002\" zeta:\"z\"]", "Task::set attribute set before interning");
+
+  Task copy (interned);
+  test.ok (copy == interned, "Task copy of interned attributes is equal");
+  copy.set ("estimate", "3");
+  test.ok (copy != interned, "Task::operator!= detects interned change");
+
+  // Task::is_due* against the cached day boundaries.
+  Task dueness;
+  dueness.set ("status", "pending");
+  dueness.set ("due", (int) Date ("yesterday").toEpoch () + 60);
+  test.ok (dueness.is_dueyesterday (), "Task::is_dueyesterday yesterday");
+  test.ok (dueness.is_overdue (), "Task::is_overdue yesterday");
+  dueness.set ("due", (int) Date ("tomorrow").toEpoch () + 60);
+  test.ok (dueness.is_duetomorrow (), "Task::is_duetomorrow tomorrow");
+  test.notok (dueness.is_duetoday (), "Task::is_duetoday not tomorrow");
+  test.notok (dueness.is_dueyesterday (), "Task::is_dueyesterday not tomorrow");
+
   // Task::validate
   Task bad ("[entry:1000000001 start:1000000000]");
   good = true;
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <main.h>
+#include <text.h>
 #include <test.h>
 
 Context context;
@@ -36,7 +37,7 @@ Context context;
 ////////////////////////////////////////////////////////////////////////////////
 int main (int argc, char** argv)
 {
-  UnitTest t (12);
+  UnitTest t (28);
 
   // Ensure environment has no influence.
   unsetenv ("TASKDATA");
@@ -95,12 +96,70 @@ int main (int argc, char** argv)
     t.is ((int) undo.size (),      7, "TDB2 after add, 7 undo lines");
     t.is ((int) backlog.size (),   2, "TDB2 after add, 2 backlog task");
 
+    // Look up the task by full and partial UUID.
+    std::string uuid = task.get ("uuid");
+    Task found;
+    t.ok (context.tdb2.get (uuid, found),                 "TDB2 get by UUID");
+    t.is (found.get ("description"), "This is a test",    "TDB2 get by UUID sees modification");
+    t.ok (context.tdb2.get (uuid.substr (0, 8), found),   "TDB2 get by partial UUID");
+    t.ok (context.tdb2.has (uuid),                        "TDB2 has UUID");
+    t.notok (context.tdb2.has (uuid.substr (0, 8)),       "TDB2 has requires full UUID");
+    t.notok (context.tdb2.get ("ffffffff-0000", found),   "TDB2 get by unknown partial UUID");
+
     context.tdb2.commit ();
+    t.notok (File ("./pending.data.new").exists (),       "TDB2 commit replaced pending.data with its rewritten copy");
 
     // Reset for reuse.
     context.tdb2.clear ();
     context.tdb2.set_location (".");
 
+    // Reload, and look up by ID.
+    t.ok (context.tdb2.get (1, found),                    "TDB2 get by ID after reload");
+    t.is (found.get ("uuid"), uuid,                       "TDB2 get by ID finds the right task");
+
+    // Enough tasks to be parsed on several threads must still be loaded, and
+    // numbered, in file order.
+    std::vector <std::string> lines;
+    for (int i = 0; i < 10000; ++i)
+      lines.push_back (format ("[description:\"task {1}\" entry:\"1234567890\" status:\"pending\" uuid:\"{2}\"]",
+                               i, uuid.substr (0, 24) + format ("{1}", 100000000000 + i).substr (0, 12)));
+    File::write ("./pending.data", lines);
+
+    context.tdb2.clear ();
+    context.tdb2.set_location (".");
+    pending = context.tdb2.pending.get_tasks ();
+
+    bool ordered = true;
+    for (unsigned int i = 0; i < pending.size (); ++i)
+      if (pending[i].id != (int) i + 1 ||
+          pending[i].get ("description") != format ("task {1}", i))
+        ordered = false;
+
+    t.is ((int) pending.size (), 10000,                   "TDB2 loaded 10000 tasks");
+    t.ok (ordered,                                        "TDB2 loaded 10000 tasks in file order");
+    t.ok (context.tdb2.get (lines[9999].substr (lines[9999].find ("uuid:") + 6, 36), found) &&
+          found.id == 10000,                              "TDB2 get by UUID after parallel load");
+
+    // Snapshot columns.
+    std::vector <Task> some;
+    some.push_back (Task ("[description:\"one\" entry:\"1000\" project:\"A\" status:\"pending\" tags:\"x,y\" uuid:\"00000000-0000-0000-0000-000000000001\"]"));
+    some.push_back (Task ("[description:\"two\" end:\"3000\" entry:\"2000\" status:\"completed\" tags:\"y\" uuid:\"00000000-0000-0000-0000-000000000002\"]"));
+
+    TDB2Snapshot snapshot;
+    context.tdb2.snapshot (some, snapshot);
+    t.is ((int) snapshot.size (), 2,                      "TDB2 snapshot has a row per task");
+    t.ok (snapshot._status[1] == Task::completed &&
+          snapshot._entry[1] == 2000 &&
+          snapshot._end[1] == 3000 &&
+          snapshot._end[0] == 0,                          "TDB2 snapshot status and dates");
+    t.ok (snapshot._projects[snapshot._project[0]] == "A" &&
+          snapshot._projects[snapshot._project[1]] == "", "TDB2 snapshot numbers projects");
+    t.ok ((int) snapshot._tag_names.size () == 2 &&
+          snapshot.tag_count (0) == 2 &&
+          snapshot.tag_count (1) == 1 &&
+          snapshot.has_tag (1, 1) &&
+          ! snapshot.has_tag (1, 0),                      "TDB2 snapshot tag bitsets");
+
     // TODO commit
     // TODO complete a task
     // TODO gc
@@ -77,6 +77,30 @@ class TestUrgencyInherit(TestCase):
         self.assertTrue(tl[1]["urgency"] >= tl[2]["urgency"] >= tl[3]["urgency"])
 
 
+class TestUrgencyInheritShared(TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.t = Task()
+
+        cls.t.config("urgency.age.coefficient", "0.0")
+        cls.t.config("urgency.blocked.coefficient", "0.0")
+        cls.t.config("urgency.blocking.coefficient", "0.0")
+        cls.t.config("urgency.inherit", "on")
+
+        cls.t("add one")
+        cls.t("add two dep:1")
+        cls.t("add three dep:1 +next due:today-1year")
+        cls.t("add four")
+        cls.t("1 modify dep:4")
+
+    def test_urgency_inherit_shared(self):
+        """Urgency is inherited from the most urgent of several blocked tasks"""
+        tasks = json.loads(self.t("rc.json.array=1 export")[1])
+        tl = dict((task["id"], task) for task in tasks)
+        self.assertTrue(tl[4]["urgency"] >= tl[1]["urgency"] >= tl[3]["urgency"])
+        self.assertTrue(tl[2]["urgency"] < tl[3]["urgency"])
+
+
 if __name__ == "__main__":
     from simpletap import TAPTestRunner
     unittest.main(testRunner=TAPTestRunner())